@@ -42,6 +42,8 @@
 
 # ROOT_DEV:	0x000 - same type of floppy as boot.
 #		0x301 - first partition on first drive etc
+#		0x901 - first partition on first virtio disk
+#		0xa01 - first partition on first AHCI disk
 	.equ ROOT_DEV, 0x301
 	ljmp    $BOOTSEG, $_start
 _start:
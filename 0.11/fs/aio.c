@@ -0,0 +1,309 @@
+/*
+ *  linux/fs/aio.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * aio.c implements asynchronous reads and writes. aio_submit() maps the
+ * transfer onto buffers and starts the block I/O with ll_rw_block(), but
+ * doesn't wait for it: a process can thus have several disk requests in
+ * flight at the same time. aio_wait() sleeps until enough of them are
+ * done, and only then copies the data out to user space - that has to
+ * happen in the context of the submitter anyway.
+ *
+ * Only regular files and block devices really go asynchronous. Pipes and
+ * character devices are done synchronously at submit time, but are still
+ * reaped with aio_wait(), so that the caller doesn't have to care.
+ */
+
+#include <errno.h>
+#include <aio.h>
+#include <sys/stat.h>
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <asm/segment.h>
+#include <asm/system.h>
+
+#define NR_AIO		32
+#define AIO_MAX_BLOCKS	8
+
+extern int sys_read(unsigned int fd,char * buf,int count);
+extern int sys_write(unsigned int fd,char * buf,int count);
+
+struct aio_req {
+	struct task_struct * task;	/* NULL if free */
+	struct aiocb * iocb;		/* user space address */
+	struct m_inode * inode;		/* NULL if done at submit time */
+	int cmd;
+	char * buf;
+	int offset;			/* into the first block */
+	int count;
+	int result;
+	int nr_blocks;
+	struct buffer_head * bh[AIO_MAX_BLOCKS];
+};
+
+static struct aio_req aio_table[NR_AIO];
+
+static int aio_done(struct aio_req * req)
+{
+	int i;
+
+	for (i=0 ; i<req->nr_blocks ; i++)
+		if (req->bh[i] && req->bh[i]->b_lock)
+			return 0;
+	return 1;
+}
+
+static void aio_free(struct aio_req * req)
+{
+	int i;
+
+	for (i=0 ; i<req->nr_blocks ; i++)
+		brelse(req->bh[i]);
+	if (req->inode)
+		iput(req->inode);
+	req->task = NULL;
+}
+
+/*
+ * Set up the buffers for one request. For regular files req->inode is
+ * used to map the file blocks, else 'block' is the first device block.
+ * Writes are copied into the buffers here, so that the user buffer is
+ * free for reuse as soon as aio_submit() returns.
+ */
+static int aio_start(struct aio_req * req, int dev, int block)
+{
+	struct m_inode * inode = req->inode;
+	struct buffer_head * bh;
+	int i, nr, chars, left, offset;
+	char * buf, * p;
+
+	left = req->count;
+	offset = req->offset;
+	buf = req->buf;
+	for (i=0 ; left>0 && i<AIO_MAX_BLOCKS ; i++,block++) {
+		chars = BLOCK_SIZE-offset;
+		if (chars > left)
+			chars = left;
+		if (!inode)
+			nr = block;
+		else if (req->cmd == LIO_READ)
+			nr = bmap(inode,block);
+		else if (!(nr = create_block(inode,block)))
+			break;
+		if (!nr && inode)
+			bh = NULL;		/* a hole reads as zeroes */
+		else if (req->cmd == LIO_READ || chars == BLOCK_SIZE)
+			bh = getblk(dev,nr);
+		else if (!(bh = bread(dev,nr)))
+			break;
+		req->bh[i] = bh;
+		req->nr_blocks = i+1;
+		if (req->cmd == LIO_WRITE) {
+			p = offset + bh->b_data;
+			left -= chars;
+			memcpy_fromfs(p,buf,chars);
+			buf += chars;
+			bh->b_uptodate = 1;
+			bh->b_dirt = 1;
+			ll_rw_block(WRITE,bh);
+		} else {
+			left -= chars;
+			if (bh && !bh->b_uptodate)
+				ll_rw_block(READ,bh);
+		}
+		offset = 0;
+	}
+	req->count -= left;
+	return req->count;
+}
+
+static int aio_submit_one(struct aiocb * iocb)
+{
+	struct aio_req * req;
+	struct file * file;
+	struct m_inode * inode;
+	int fd, cmd, count, dev;
+	off_t pos;
+	char * buf;
+
+	fd = get_fs_long((unsigned long *) &iocb->aio_fildes);
+	cmd = get_fs_long((unsigned long *) &iocb->aio_lio_opcode);
+	buf = (char *) get_fs_long((unsigned long *) &iocb->aio_buf);
+	pos = get_fs_long((unsigned long *) &iocb->aio_offset);
+	count = get_fs_long((unsigned long *) &iocb->aio_nbytes);
+	if (fd >= NR_OPEN || !(file=current->filp[fd]))
+		return -EBADF;
+	if (count < 0 || pos < 0)
+		return -EINVAL;
+	if (cmd != LIO_READ && cmd != LIO_WRITE)
+		return -EINVAL;
+	for (req = aio_table ; req < aio_table+NR_AIO ; req++)
+		if (!req->task)
+			break;
+	if (req >= aio_table+NR_AIO)
+		return -EAGAIN;
+	req->task = current;
+	req->iocb = iocb;
+	req->inode = NULL;
+	req->cmd = cmd;
+	req->buf = buf;
+	req->offset = pos & (BLOCK_SIZE-1);
+	req->count = count;
+	req->result = 0;
+	req->nr_blocks = 0;
+	verify_area(&iocb->aio_result,4);
+	put_fs_long(-EINPROGRESS,(unsigned long *) &iocb->aio_result);
+	inode = file->f_inode;
+	if (S_ISBLK(inode->i_mode))
+		dev = inode->i_zone[0];
+	else if (S_ISREG(inode->i_mode)) {
+		dev = inode->i_dev;
+		if (cmd == LIO_READ && count > (int) inode->i_size - pos)
+			req->count = count = inode->i_size - pos;
+	} else {
+		req->result = (cmd == LIO_READ) ?
+			sys_read(fd,buf,count) : sys_write(fd,buf,count);
+		return 0;
+	}
+	if (count <= 0)
+		return 0;
+	if (S_ISREG(inode->i_mode)) {
+		inode->i_count++;
+		req->inode = inode;
+	}
+	if (!aio_start(req,dev,pos >> BLOCK_SIZE_BITS)) {
+		req->result = -ENOSPC;
+		return 0;
+	}
+	if (cmd == LIO_WRITE && S_ISREG(inode->i_mode)) {
+		if (pos + req->count > inode->i_size)
+			inode->i_size = pos + req->count;
+		inode->i_mtime = inode->i_ctime = CURRENT_TIME;
+		inode->i_dirt = 1;
+	}
+	return 0;
+}
+
+/*
+ * Copy the result of a finished request out to user space and free it.
+ */
+static void aio_reap(struct aio_req * req)
+{
+	struct buffer_head * bh;
+	int i, chars, left, offset;
+	char * buf;
+
+	if (!req->result && req->cmd == LIO_READ && req->count > 0) {
+		verify_area(req->buf,req->count);
+		buf = req->buf;
+		left = req->count;
+		offset = req->offset;
+		for (i=0 ; i<req->nr_blocks ; i++) {
+			chars = BLOCK_SIZE-offset;
+			if (chars > left)
+				chars = left;
+			bh = req->bh[i];
+			if (bh && !bh->b_uptodate)
+				break;
+			left -= chars;
+			if (bh) {
+				memcpy_tofs(buf,offset + bh->b_data,chars);
+				buf += chars;
+			} else
+				while (chars-->0)
+					put_fs_byte(0,buf++);
+			offset = 0;
+		}
+		req->result = (left == req->count) ? -EIO : req->count - left;
+	} else if (!req->result) {
+		for (i=0 ; i<req->nr_blocks ; i++)
+			if (!req->bh[i]->b_uptodate)
+				break;
+		if (i < req->nr_blocks && !i)
+			req->result = -EIO;
+		else if (i < req->nr_blocks)
+			req->result = i*BLOCK_SIZE - req->offset;
+		else
+			req->result = req->count;
+	}
+	verify_area(&req->iocb->aio_result,4);
+	put_fs_long(req->result,(unsigned long *) &req->iocb->aio_result);
+	aio_free(req);
+}
+
+int sys_aio_submit(int nr, struct aiocb ** list)
+{
+	int i, retval;
+
+	if (nr <= 0)
+		return -EINVAL;
+	for (i=0 ; i<nr ; i++) {
+		retval = aio_submit_one((struct aiocb *)
+			get_fs_long((unsigned long *) (list+i)));
+		if (retval < 0)
+			return i ? i : retval;
+	}
+	return nr;
+}
+
+/*
+ * aio_wait() waits until at least 'min_nr' of our requests are done (0
+ * just polls), reaps up to 'nr' of them, and stores their aiocb pointers
+ * in 'list'. It returns the number of requests reaped.
+ */
+int sys_aio_wait(int min_nr, int nr, struct aiocb ** list)
+{
+	struct buffer_head * locked[NR_AIO];
+	struct aio_req * req;
+	int done, pending, n, i;
+
+	if (nr <= 0 || min_nr < 0 || min_nr > nr)
+		return -EINVAL;
+	verify_area(list,nr*sizeof(struct aiocb *));
+	for (;;) {
+		done = pending = n = 0;
+		for (req = aio_table ; req < aio_table+NR_AIO ; req++) {
+			if (req->task != current)
+				continue;
+			if (aio_done(req)) {
+				done++;
+				continue;
+			}
+			pending++;
+			for (i=0 ; i<req->nr_blocks ; i++)
+				if (req->bh[i] && req->bh[i]->b_lock) {
+					locked[n++] = req->bh[i];
+					break;
+				}
+		}
+		if (done >= min_nr || !pending)
+			break;
+		if (wait_on_requests(locked,n) && !done)
+			return -EINTR;
+	}
+	for (n=0,req = aio_table ; n<nr && req < aio_table+NR_AIO ; req++) {
+		if (req->task != current || !aio_done(req))
+			continue;
+		put_fs_long((unsigned long) req->iocb,(unsigned long *) (list+n));
+		aio_reap(req);
+		n++;
+	}
+	return n;
+}
+
+/*
+ * Called on exit and exec: there is no-one left to reap the results, so
+ * just drop them. brelse() waits for the I/O still in flight.
+ */
+void exit_aio(void)
+{
+	struct aio_req * req;
+
+	for (req = aio_table ; req < aio_table+NR_AIO ; req++)
+		if (req->task == current)
+			aio_free(req);
+}
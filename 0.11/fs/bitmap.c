@@ -44,24 +44,54 @@ __asm__ __volatile__ ("cld\n" \
 	:"=c" (__res):"c" (0),"S" (addr)); \
 __res;})
 
+#define first_set(word) ({ \
+int __res; \
+__asm__ ("bsfl %1,%0":"=r" (__res):"rm" (word)); \
+__res;})
+
+/* like find_first_zero(), but starts looking at bit 'nr' */
+static int find_next_zero(char * addr, int nr)
+{
+	unsigned long * p = (nr>>5) + (unsigned long *) addr;
+	unsigned long word;
+
+	if (nr & 31) {
+		if ((word = ~*p >> (nr & 31)))
+			return nr + first_set(word);
+		nr = (nr | 31) + 1;
+		p++;
+	}
+	for ( ; nr < 8192 ; nr += 32, p++)
+		if (~*p)
+			return nr + first_set(~*p);
+	return 8192;
+}
+
+/*
+ * NOTE! new_block() and free_block() deal in zones, which are
+ * 2^s_log_zone_size blocks each: zone z is blocks z<<s_log_zone_size
+ * and up.
+ */
 void free_block(int dev, int block)
 {
 	struct super_block * sb;
 	struct buffer_head * bh;
+	int i;
 
 	if (!(sb = get_super(dev)))
 		panic("trying to free block on nonexistent device");
 	if (block < sb->s_firstdatazone || block >= sb->s_nzones)
 		panic("trying to free block not in datazone");
-	bh = get_hash_table(dev,block);
-	if (bh) {
-		if (bh->b_count != 1) {
-			printk("trying to free block (%04x:%d), count=%d\n",
-				dev,block,bh->b_count);
-			return;
-		}
+	for (i=0 ; i < (1 << sb->s_log_zone_size) ; i++) {
+		bh = get_hash_table(dev,(block << sb->s_log_zone_size)+i);
+		if (!bh)
+			continue;
 		bh->b_dirt=0;
-		bh->b_uptodate=0;
+/* still in use (a pipe may hold it): keep the data, but not the zone */
+		if (bh->b_count != 1)
+			set_blocknr(bh,0,0);
+		else
+			bh->b_uptodate=0;
 		brelse(bh);
 	}
 	block -= sb->s_firstdatazone - 1 ;
@@ -70,37 +100,64 @@ void free_block(int dev, int block)
 		panic("free_block: bit already cleared");
 	}
 	sb->s_zmap[block/8192]->b_dirt = 1;
+	sb->s_zfree[block/8192]++;
+	sb->s_free_zones++;
 }
 
-int new_block(int dev)
+/*
+ * new_block() first tries 'goal', which is normally the zone after the
+ * one the file used last, so that files are laid out sequentially and
+ * their reads can be merged. Failing that (or with goal 0), it takes the
+ * first free zone after the last one allocated on the device, so new
+ * files go after the old ones instead of into the first hole on the disk.
+ */
+int new_block(int dev, int goal)
 {
 	struct buffer_head * bh;
 	struct super_block * sb;
-	int i,j;
+	int i,j,n,nbits;
 
 	if (!(sb = get_super(dev)))
 		panic("trying to get new block from nonexistant device");
-	j = 8192;
-	for (i=0 ; i<8 ; i++)
-		if ((bh=sb->s_zmap[i]))
-			if ((j=find_first_zero(bh->b_data))<8192)
-				break;
-	if (i>=8 || !bh || j>=8192)
+	if (sb->s_free_zones <= sb->s_reserved)
+		return 0;		/* the rest is promised, see delalloc.c */
+	nbits = sb->s_nzones - (sb->s_firstdatazone-1);
+	j = goal - (sb->s_firstdatazone-1);
+	if (goal >= sb->s_firstdatazone && goal < sb->s_nzones &&
+	    (bh = sb->s_zmap[j>>13]) && !set_bit(j&8191,bh->b_data))
+		goto found;
+	if (sb->s_zcursor >= nbits)
+		sb->s_zcursor = 0;
+	i = sb->s_zcursor >> 13;
+	j = sb->s_zcursor & 8191;
+	for (n=0 ; n<=Z_MAP_SLOTS ; n++,i=(i+1)%Z_MAP_SLOTS,j=0) {
+		if (!(bh=sb->s_zmap[i]) || !sb->s_zfree[i])
+			continue;
+		j = find_next_zero(bh->b_data,j);
+		if (j < 8192 && j+i*8192 < nbits)
+			break;
+	}
+	if (n>Z_MAP_SLOTS)
 		return 0;
 	if (set_bit(j,bh->b_data))
 		panic("new_block: bit already set");
+	j += i*8192;
+found:
 	bh->b_dirt = 1;
-	j += i*8192 + sb->s_firstdatazone-1;
-	if (j >= sb->s_nzones)
-		return 0;
-	if (!(bh=getblk(dev,j)))
-		panic("new_block: cannot get block");
-	if (bh->b_count != 1)
-		panic("new block: count is != 1");
-	clear_block(bh->b_data);
-	bh->b_uptodate = 1;
-	bh->b_dirt = 1;
-	brelse(bh);
+	sb->s_zfree[j>>13]--;
+	sb->s_free_zones--;
+	sb->s_zcursor = j+1;
+	j += sb->s_firstdatazone-1;
+	for (n=0 ; n < (1 << sb->s_log_zone_size) ; n++) {
+		if (!(bh=getblk(dev,(j << sb->s_log_zone_size)+n)))
+			panic("new_block: cannot get block");
+		if (bh->b_count != 1)
+			panic("new block: count is != 1");
+		clear_block(bh->b_data);
+		bh->b_uptodate = 1;
+		bh->b_dirt = 1;
+		brelse(bh);
+	}
 	return j;
 }
 
@@ -112,7 +169,7 @@ void free_inode(struct m_inode * inode)
 	if (!inode)
 		return;
 	if (!inode->i_dev) {
-		memset(inode,0,sizeof(*inode));
+		clear_inode(inode);
 		return;
 	}
 	if (inode->i_count>1) {
@@ -129,8 +186,12 @@ void free_inode(struct m_inode * inode)
 		panic("nonexistent imap in superblock");
 	if (clear_bit(inode->i_num&8191,bh->b_data))
 		printk("free_inode: bit already cleared.\n\r");
+	else {
+		sb->s_ifree[inode->i_num>>13]++;
+		sb->s_free_inodes++;
+	}
 	bh->b_dirt = 1;
-	memset(inode,0,sizeof(*inode));
+	clear_inode(inode);
 }
 
 struct m_inode * new_inode(int dev)
@@ -145,8 +206,8 @@ struct m_inode * new_inode(int dev)
 	if (!(sb = get_super(dev)))
 		panic("new_inode with unknown device");
 	j = 8192;
-	for (i=0 ; i<8 ; i++)
-		if ((bh=sb->s_imap[i]))
+	for (i=0 ; i<I_MAP_SLOTS ; i++)
+		if ((bh=sb->s_imap[i]) && sb->s_ifree[i])
 			if ((j=find_first_zero(bh->b_data))<8192)
 				break;
 	if (!bh || j >= 8192 || j+i*8192 > sb->s_ninodes) {
@@ -156,6 +217,8 @@ struct m_inode * new_inode(int dev)
 	if (set_bit(j,bh->b_data))
 		panic("new_inode: bit already set");
 	bh->b_dirt = 1;
+	sb->s_ifree[i]--;
+	sb->s_free_inodes--;
 	inode->i_count=1;
 	inode->i_nlinks=1;
 	inode->i_dev=dev;
@@ -163,6 +226,36 @@ struct m_inode * new_inode(int dev)
 	inode->i_gid=current->egid;
 	inode->i_dirt=1;
 	inode->i_num = j + i*8192;
+	insert_inode_hash(inode);
 	inode->i_mtime = inode->i_atime = inode->i_ctime = CURRENT_TIME;
 	return inode;
 }
+
+static int count_map(struct buffer_head ** map, unsigned short * free,
+	int slots, int nbits)
+{
+	int i,j,total=0;
+
+	for (i=0 ; i<slots ; i++) {
+		free[i] = 0;
+		if (!map[i])
+			continue;
+		for (j=0 ; j<8192 && j+i*8192 < nbits ; j++)
+			if (!(map[i]->b_data[j>>3] & (1<<(j&7))))
+				free[i]++;
+		total += free[i];
+	}
+	return total;
+}
+
+/*
+ * Called by read_super(): count the free bits in each bitmap block once,
+ * so that allocation can skip the full ones and ustat() needn't scan.
+ */
+void count_free(struct super_block * sb)
+{
+	sb->s_free_inodes = count_map(sb->s_imap,sb->s_ifree,I_MAP_SLOTS,
+		sb->s_ninodes+1);
+	sb->s_free_zones = count_map(sb->s_zmap,sb->s_zfree,Z_MAP_SLOTS,
+		sb->s_nzones-sb->s_firstdatazone+1);
+}
@@ -44,22 +44,38 @@ static inline void wait_on_buffer(struct buffer_head * bh)
 	sti();
 }
 
+/*
+ * sys_sync() and sync_dev() wait for the writes to reach the drive, and
+ * then have the drive flush its write cache: when they return, the data
+ * is on the media.
+ */
 int sys_sync(void)
 {
 	int i;
 	struct buffer_head * bh;
 
+	flush_all_delayed(0);
 	sync_inodes();		/* write out inodes into buffers */
 	bh = start_buffer;
 	for (i=0 ; i<NR_BUFFERS ; i++,bh++) {
 		wait_on_buffer(bh);
-		if (bh->b_dirt)
+		if (bh->b_dirt && bh->b_dev)
 			ll_rw_block(WRITE,bh);
 	}
+	bh = start_buffer;
+	for (i=0 ; i<NR_BUFFERS ; i++,bh++)
+		wait_on_buffer(bh);
+	for (i=0 ; i<NR_SUPER ; i++)
+		if (super_block[i].s_dev)
+			ll_rw_flush(super_block[i].s_dev);
 	return 0;
 }
 
-int sync_dev(int dev)
+/*
+ * Start writing out the dirty buffers of a device, without waiting.
+ * getblk() uses this directly when it needs a clean buffer.
+ */
+static void write_dev(int dev)
 {
 	int i;
 	struct buffer_head * bh;
@@ -81,10 +97,24 @@ int sync_dev(int dev)
 		if (bh->b_dev == dev && bh->b_dirt)
 			ll_rw_block(WRITE,bh);
 	}
+}
+
+int sync_dev(int dev)
+{
+	int i;
+	struct buffer_head * bh;
+
+	flush_all_delayed(dev);
+	write_dev(dev);
+	bh = start_buffer;
+	for (i=0 ; i<NR_BUFFERS ; i++,bh++)
+		if (bh->b_dev == dev)
+			wait_on_buffer(bh);
+	ll_rw_flush(dev);
 	return 0;
 }
 
-static inline void invalidate_buffers(int dev)
+void invalidate_buffers(int dev)
 {
 	int i;
 	struct buffer_head * bh;
@@ -215,7 +245,7 @@ repeat:
 		return bh;
 	tmp = free_list;
 	do {
-		if (tmp->b_count)
+		if (tmp->b_count || tmp->b_inode)	/* see delalloc.c */
 			continue;
 		if (!bh || BADNESS(tmp)<BADNESS(bh)) {
 			bh = tmp;
@@ -232,7 +262,7 @@ repeat:
 	if (bh->b_count)
 		goto repeat;
 	while (bh->b_dirt) {
-		sync_dev(bh->b_dev);
+		write_dev(bh->b_dev);
 		wait_on_buffer(bh);
 		if (bh->b_count)
 			goto repeat;
@@ -253,6 +283,19 @@ repeat:
 	return bh;
 }
 
+/*
+ * Move a buffer to another block: delalloc.c uses this when a delayed
+ * block gets its zone. The caller makes sure there is no other buffer
+ * for the block.
+ */
+void set_blocknr(struct buffer_head * bh, int dev, int block)
+{
+	remove_from_queues(bh);
+	bh->b_dev = dev;
+	bh->b_blocknr = block;
+	insert_into_queues(bh);
+}
+
 void brelse(struct buffer_head * buf)
 {
 	if (!buf)
@@ -0,0 +1,165 @@
+/*
+ *  linux/fs/dcache.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * dcache.c remembers the results of directory lookups: (device,
+ * directory inode, name) -> inode number. A cached lookup doesn't have
+ * to read and search the directory at all. Names that aren't there are
+ * remembered too (as inode number 0), since failing lookups along PATH
+ * are at least as common as successful ones.
+ *
+ * The cache knows nothing about the filesystem: namei.c has to tell it
+ * whenever an entry is added or removed. Every such change also bumps
+ * dcache_seq, so that a lookup that slept in the directory scan can
+ * tell that what it found may already be out of date.
+ */
+
+#include <string.h>
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+
+#define NR_DCACHE	256
+#define NR_DHASH	64
+
+struct dcache_entry {
+	int d_dev;
+	int d_dir;
+	int d_ino;			/* 0 - name doesn't exist */
+	int d_len;
+	char d_name[NAME_LEN];
+	struct dcache_entry * d_next;	/* hash chain */
+	struct dcache_entry * d_prev_lru, * d_next_lru;
+};
+
+static struct dcache_entry dcache[NR_DCACHE];
+static struct dcache_entry * dhash[NR_DHASH];
+static struct dcache_entry * dlru = NULL;	/* least recently used */
+
+unsigned long dcache_seq = 0;
+
+static int dhashfn(int dev, int dir, const char * name, int len)
+{
+	unsigned int h = dev ^ (dir << 4);
+
+	while (len--)
+		h = (h << 3) ^ (h >> 28) ^ *(name++);
+	return h % NR_DHASH;
+}
+
+static void unhash(struct dcache_entry * d)
+{
+	struct dcache_entry ** p;
+
+	if (!d->d_dev)
+		return;
+	for (p = dhash + dhashfn(d->d_dev,d->d_dir,d->d_name,d->d_len) ;
+	     *p ; p = &(*p)->d_next)
+		if (*p == d) {
+			*p = d->d_next;
+			break;
+		}
+	d->d_dev = 0;
+}
+
+/* the list is circular: dlru is the oldest, dlru->d_prev_lru the newest */
+static void init_lru(void)
+{
+	int i;
+
+	for (i=0 ; i<NR_DCACHE ; i++) {
+		dcache[i].d_next_lru = dcache+(i+1)%NR_DCACHE;
+		dcache[i].d_prev_lru = dcache+(i+NR_DCACHE-1)%NR_DCACHE;
+	}
+	dlru = dcache;
+}
+
+static void touch(struct dcache_entry * d)
+{
+	if (d == dlru) {
+		dlru = d->d_next_lru;
+		return;
+	}
+	d->d_prev_lru->d_next_lru = d->d_next_lru;
+	d->d_next_lru->d_prev_lru = d->d_prev_lru;
+	d->d_next_lru = dlru;
+	d->d_prev_lru = dlru->d_prev_lru;
+	dlru->d_prev_lru->d_next_lru = d;
+	dlru->d_prev_lru = d;
+}
+
+static struct dcache_entry * find(int dev, int dir, const char * name, int len)
+{
+	struct dcache_entry * d;
+
+	for (d = dhash[dhashfn(dev,dir,name,len)] ; d ; d = d->d_next)
+		if (d->d_dev == dev && d->d_dir == dir && d->d_len == len &&
+		    !strncmp(d->d_name,name,len))
+			return d;
+	return NULL;
+}
+
+/*
+ * Returns the inode number, 0 if the name is known not to exist, and
+ * -1 if we don't know.
+ */
+int dcache_lookup(struct m_inode * dir, const char * name, int len)
+{
+	struct dcache_entry * d;
+
+	if (!(d = find(dir->i_dev,dir->i_num,name,len)))
+		return -1;
+	touch(d);
+	return d->d_ino;
+}
+
+void dcache_add(struct m_inode * dir, const char * name, int len, int ino)
+{
+	struct dcache_entry * d;
+
+	if (len > NAME_LEN)
+		return;
+	if (!dlru)
+		init_lru();
+	if (!(d = find(dir->i_dev,dir->i_num,name,len))) {
+		d = dlru;
+		touch(d);
+		unhash(d);
+		d->d_dev = dir->i_dev;
+		d->d_dir = dir->i_num;
+		d->d_len = len;
+		strncpy(d->d_name,name,len);
+		d->d_next = dhash[dhashfn(d->d_dev,d->d_dir,name,len)];
+		dhash[dhashfn(d->d_dev,d->d_dir,name,len)] = d;
+	} else
+		touch(d);
+	d->d_ino = ino;
+}
+
+/* the entry for 'name' in 'dir' has been added or removed */
+void dcache_remove(struct m_inode * dir, const char * name, int len)
+{
+	struct dcache_entry * d;
+
+	dcache_seq++;
+	if ((d = find(dir->i_dev,dir->i_num,name,len)))
+		unhash(d);
+}
+
+/*
+ * A directory has been removed (its inode number may be reused for
+ * something else), or a device unmounted: drop everything under it.
+ * dir == 0 means the whole device.
+ */
+void dcache_remove_dir(int dev, int dir)
+{
+	int i;
+
+	dcache_seq++;
+	for (i=0 ; i<NR_DCACHE ; i++)
+		if (dcache[i].d_dev == dev && (!dir || dcache[i].d_dir == dir))
+			unhash(dcache+i);
+}
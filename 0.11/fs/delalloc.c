@@ -0,0 +1,181 @@
+/*
+ *  linux/fs/delalloc.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * delalloc.c implements delayed allocation for file_write(). A block
+ * that isn't mapped yet doesn't get a zone when it is written to: the
+ * data goes into a buffer that belongs to the inode (b_inode, with the
+ * logical block number in b_blocknr and no device, so it isn't in the
+ * hash table), and the zones it will need are only reserved in the
+ * super-block. The zones are allocated by flush_delayed(), lowest
+ * logical block first, so that a file written in small pieces still
+ * ends up contiguous.
+ *
+ * The delayed blocks of an inode are flushed when the inode is last
+ * iput(), on sync, and by bmap()/create_block(): whoever wants to know
+ * where a block is on disk gets the real answer. getblk() never takes
+ * a delayed buffer, so at most half the buffer cache is used for them.
+ */
+
+#include <string.h>
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <asm/system.h>
+
+static int nr_delayed = 0;
+
+static inline void wait_on_buffer(struct buffer_head * bh)
+{
+	cli();
+	while (bh->b_lock)
+		sleep_on(&bh->b_wait);
+	sti();
+}
+
+/*
+ * A block past the direct ones may need up to three indirect blocks as
+ * well (v2), and the boundaries depend on the filesystem version and
+ * zone size: just reserve the worst case.
+ */
+static int zones_needed(int block)
+{
+	return block < 7 ? 1 : 4;
+}
+
+static void unlink_delayed(struct m_inode * inode, struct buffer_head * bh)
+{
+	struct buffer_head ** p;
+
+	for (p = &inode->i_delayed ; *p ; p = &(*p)->b_delay_next)
+		if (*p == bh) {
+			*p = bh->b_delay_next;
+			break;
+		}
+	bh->b_delay_next = NULL;
+	bh->b_inode = NULL;
+	nr_delayed--;
+}
+
+/*
+ * Returns the (delayed) buffer for a block that isn't mapped, with
+ * b_count raised. If the block is mapped, NULL is returned and *zone
+ * is set to it. NULL with *zone == 0 means that the block has to be
+ * allocated right away, as there is too little space (or too many
+ * delayed buffers) to reserve it.
+ */
+struct buffer_head * get_delayed(struct m_inode * inode, int block, int * zone)
+{
+	struct super_block * sb;
+	struct buffer_head * bh, * tmp;
+
+	*zone = 0;
+repeat:
+	for (bh = inode->i_delayed ; bh ; bh = bh->b_delay_next)
+		if (bh->b_blocknr == block)
+			break;
+	if (bh) {
+		bh->b_count++;
+		wait_on_buffer(bh);
+		if (bh->b_inode == inode && bh->b_blocknr == block)
+			return bh;
+		brelse(bh);
+		goto repeat;
+	}
+	if ((*zone = _bmap(inode,block,0)))
+		return NULL;
+	if (!(sb = get_super(inode->i_dev)) || nr_delayed >= NR_BUFFERS/2 ||
+	    sb->s_free_zones < sb->s_reserved + zones_needed(block))
+		return NULL;
+	bh = getblk(0,block);		/* a free buffer that isn't hashed */
+	for (tmp = inode->i_delayed ; tmp ; tmp = tmp->b_delay_next)
+		if (tmp->b_blocknr == block) {
+			brelse(bh);
+			goto repeat;
+		}
+	if (sb->s_free_zones < sb->s_reserved + zones_needed(block)) {
+		brelse(bh);
+		return NULL;
+	}
+	sb->s_reserved += zones_needed(block);
+	memset(bh->b_data,0,BLOCK_SIZE);
+	bh->b_uptodate = 1;
+	bh->b_inode = inode;
+	bh->b_delay_next = inode->i_delayed;
+	inode->i_delayed = bh;
+	nr_delayed++;
+	return bh;
+}
+
+/*
+ * Give all delayed blocks of an inode their zones. The buffer becomes
+ * the buffer of the new zone, so someone still writing into it doesn't
+ * notice. new_block() has left a zeroed buffer for the zone in the
+ * cache: that one is thrown away.
+ */
+void flush_delayed(struct m_inode * inode)
+{
+	struct super_block * sb;
+	struct buffer_head * bh, * tmp;
+	int nr;
+
+	while (inode->i_delayed) {
+		bh = NULL;
+		for (tmp = inode->i_delayed ; tmp ; tmp = tmp->b_delay_next)
+			if (!tmp->b_lock && (!bh || tmp->b_blocknr < bh->b_blocknr))
+				bh = tmp;
+		if (!bh) {		/* somebody else is flushing them */
+			wait_on_buffer(inode->i_delayed);
+			continue;
+		}
+		bh->b_lock = 1;
+		if ((sb = get_super(inode->i_dev)))
+			sb->s_reserved -= zones_needed(bh->b_blocknr);
+		if ((nr = _bmap(inode,bh->b_blocknr,1))) {
+			if ((tmp = get_hash_table(inode->i_dev,nr))) {
+				tmp->b_dirt = tmp->b_uptodate = 0;
+				set_blocknr(tmp,0,0);
+				brelse(tmp);
+			}
+			set_blocknr(bh,inode->i_dev,nr);
+		} else {
+			printk("delayed block %d of inode %d (dev %04x) lost: "
+				"no space\n\r",bh->b_blocknr,inode->i_num,
+				inode->i_dev);
+			bh->b_dirt = bh->b_uptodate = 0;
+		}
+		unlink_delayed(inode,bh);
+		bh->b_lock = 0;
+		wake_up(&bh->b_wait);
+	}
+}
+
+/* the file is truncated: the delayed data just goes away */
+void drop_delayed(struct m_inode * inode)
+{
+	struct super_block * sb;
+	struct buffer_head * bh;
+
+	while ((bh = inode->i_delayed)) {
+		wait_on_buffer(bh);
+		if (bh != inode->i_delayed)
+			continue;
+		if ((sb = get_super(inode->i_dev)))
+			sb->s_reserved -= zones_needed(bh->b_blocknr);
+		bh->b_dirt = bh->b_uptodate = 0;
+		unlink_delayed(inode,bh);
+	}
+}
+
+/* dev == 0 means all devices */
+void flush_all_delayed(int dev)
+{
+	struct m_inode * inode;
+
+	for (inode = inode_list ; inode ; inode = inode->i_list)
+		if (inode->i_delayed && (!dev || inode->i_dev == dev))
+			flush_delayed(inode);
+}
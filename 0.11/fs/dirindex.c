@@ -0,0 +1,246 @@
+/*
+ *  linux/fs/dirindex.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * dirindex.c keeps a hash index of the names in large directories, so
+ * that find_entry() doesn't have to read every block of a directory
+ * with thousands of entries. The index is built the first time such a
+ * directory is searched, and kept up to date by namei.c as entries are
+ * added and removed. Small directories are just scanned.
+ *
+ * A slot holds the entry number (plus one) in its low 16 bits and the
+ * high 16 bits of the name hash in the others, so most other names in
+ * a probe sequence are skipped without reading their block. What the
+ * index returns are only candidates, which find_entry() still compares.
+ * But a name that isn't in the index isn't looked for anywhere else: the
+ * index has to be complete, so everything that writes a directory entry
+ * has to call dindex_add() or dindex_remove(). Indexes are few, and are
+ * dropped when the inode goes or the directory grows too large.
+ */
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <asm/segment.h>
+
+#define NR_DINDEX	8
+#define DINDEX_PAGES	8
+#define SLOTS_PER_PAGE	(PAGE_SIZE/sizeof(unsigned long))
+#define MAX_SLOTS	(DINDEX_PAGES*SLOTS_PER_PAGE)
+#define DINDEX_MIN	(4*DIR_ENTRIES_PER_BLOCK)	/* smaller ones are scanned */
+#define DINDEX_MAX	(MAX_SLOTS/4*3)
+
+#define EMPTY		0
+#define DELETED		0xffffffff
+
+struct dir_index {
+	struct m_inode * d_dir;		/* NULL - free */
+	int d_building;
+	int d_stale;			/* changed while building */
+	unsigned long d_mask;		/* slots-1 */
+	unsigned long d_used;		/* slots that aren't EMPTY */
+	long d_lru;			/* jiffies of last use */
+	unsigned long * d_page[DINDEX_PAGES];
+};
+
+static struct dir_index dindex[NR_DINDEX];
+
+static unsigned long hash(const char * name, int len)
+{
+	unsigned long h = 0;
+
+	while (len--)
+		h = (h << 3) ^ (h >> 28) ^ *(name++);
+	return h;
+}
+
+static inline unsigned long * slot(struct dir_index * d, unsigned long i)
+{
+	i &= d->d_mask;
+	return d->d_page[i / SLOTS_PER_PAGE] + i % SLOTS_PER_PAGE;
+}
+
+static int namelen(struct dir_entry * de)
+{
+	int len;
+
+	for (len = 0 ; len < NAME_LEN && de->name[len] ; len++)
+		/* nothing */ ;
+	return len;
+}
+
+static void free_index(struct dir_index * d)
+{
+	int i;
+
+	for (i=0 ; i<DINDEX_PAGES ; i++)
+		if (d->d_page[i]) {
+			free_page((unsigned long) d->d_page[i]);
+			d->d_page[i] = NULL;
+		}
+	if (d->d_dir)
+		d->d_dir->i_index = NULL;
+	d->d_dir = NULL;
+}
+
+static void insert(struct dir_index * d, struct dir_entry * de, int nr)
+{
+	unsigned long h = hash(de->name,namelen(de));
+	unsigned long i, * p;
+
+	for (i = h ; *(p = slot(d,i)) != EMPTY && *p != DELETED ; i++)
+		/* nothing */ ;
+	if (*p == EMPTY)
+		d->d_used++;
+	*p = (h & 0xffff0000) | (nr+1);
+}
+
+/*
+ * Build the index of a directory. Reading the directory sleeps: if it
+ * changes meanwhile, the index is thrown away again.
+ */
+static struct dir_index * build(struct m_inode * dir)
+{
+	struct dir_index * d, * tmp;
+	struct buffer_head * bh;
+	struct dir_entry * de;
+	int entries, slots, nr, i, block;
+
+	entries = dir->i_size / sizeof (struct dir_entry);
+	if (entries < DINDEX_MIN || entries > DINDEX_MAX)
+		return NULL;
+	d = NULL;
+	for (tmp = dindex ; tmp < dindex+NR_DINDEX ; tmp++) {
+		if (!tmp->d_dir) {
+			d = tmp;
+			break;
+		}
+		if (!tmp->d_building && (!d || tmp->d_lru < d->d_lru))
+			d = tmp;
+	}
+	if (!d)
+		return NULL;
+	free_index(d);
+	for (slots = SLOTS_PER_PAGE ; slots < 2*entries && slots < MAX_SLOTS ; )
+		slots <<= 1;
+	for (i=0 ; i*SLOTS_PER_PAGE < slots ; i++) {
+		if (!(d->d_page[i] = (unsigned long *) get_free_page())) {
+			free_index(d);
+			return NULL;
+		}
+	}
+	d->d_mask = slots-1;
+	d->d_used = 0;
+	d->d_lru = jiffies;
+	d->d_building = 1;
+	d->d_stale = 0;
+	d->d_dir = dir;
+	dir->i_index = d;
+	for (nr = 0 ; nr < entries ; nr += DIR_ENTRIES_PER_BLOCK) {
+		if (!(block = bmap(dir,nr/DIR_ENTRIES_PER_BLOCK)))
+			continue;
+		if (!(bh = bread(dir->i_dev,block))) {
+			d->d_stale = 1;
+			break;
+		}
+		de = (struct dir_entry *) bh->b_data;
+		for (i=0 ; i<DIR_ENTRIES_PER_BLOCK && nr+i<entries ; i++,de++)
+			if (de->inode)
+				insert(d,de,nr+i);
+		brelse(bh);
+	}
+	d->d_building = 0;
+	if (d->d_stale || dir->i_index != d) {
+		free_index(d);
+		return NULL;
+	}
+	return d;
+}
+
+/*
+ * Look a name (in user space) up in the index of 'dir'. Returns the
+ * number of candidate entries put in 'nr' (0 if the name isn't there),
+ * or -1 if there is no index or too many candidates: the directory has
+ * to be scanned then.
+ */
+int dindex_find(struct m_inode * dir, const char * name, int len,
+	int * nr, int max)
+{
+	char buf[NAME_LEN];
+	struct dir_index * d;
+	unsigned long h, i, * p;
+	int n;
+
+	if (dir->i_size < DINDEX_MIN * sizeof (struct dir_entry))
+		return -1;
+	if (!(d = dir->i_index) && !(d = build(dir)))
+		return -1;
+	if (d->d_building)
+		return -1;
+	d->d_lru = jiffies;
+	if (len > NAME_LEN)
+		len = NAME_LEN;
+	for (n=0 ; n<len ; n++)
+		buf[n] = get_fs_byte(name+n);
+	h = hash(buf,len);
+	n = 0;
+	for (i = h ; (p = slot(d,i)), *p != EMPTY ; i++) {
+		if (*p == DELETED || (*p & 0xffff0000) != (h & 0xffff0000))
+			continue;
+		if (n >= max)
+			return -1;
+		nr[n++] = (*p & 0xffff) - 1;
+	}
+	return n;
+}
+
+/* entry 'nr' of 'dir' has just got the name in 'de' */
+void dindex_add(struct m_inode * dir, struct dir_entry * de, int nr)
+{
+	struct dir_index * d;
+
+	if (!(d = dir->i_index))
+		return;
+	if (d->d_building)
+		d->d_stale = 1;
+	else if (nr >= DINDEX_MAX || d->d_used >= (d->d_mask+1)/4*3)
+		free_index(d);		/* rebuilt (larger) when next used */
+	else
+		insert(d,de,nr);
+}
+
+/* entry 'nr' of 'dir', with the name in 'de', is being removed */
+void dindex_remove(struct m_inode * dir, struct dir_entry * de, int nr)
+{
+	struct dir_index * d;
+	unsigned long h, i, * p;
+
+	if (!(d = dir->i_index))
+		return;
+	if (d->d_building) {
+		d->d_stale = 1;
+		return;
+	}
+	h = hash(de->name,namelen(de));
+	for (i = h ; *(p = slot(d,i)) != EMPTY ; i++)
+		if (*p == ((h & 0xffff0000) | (nr+1))) {
+			*p = DELETED;
+			return;
+		}
+}
+
+/* the inode is going away */
+void dindex_drop(struct m_inode * dir)
+{
+	struct dir_index * d;
+
+	if (!(d = dir->i_index))
+		return;
+	if (d->d_building)
+		d->d_stale = 1;
+	else
+		free_index(d);
+}
@@ -218,7 +218,7 @@ restart_interp:
 		retval = -ENOEXEC;
 		goto exec_error2;
 	}
-	if (!(bh = bread(inode->i_dev,inode->i_zone[0]))) {
+	if (!(bh = bread(inode->i_dev,bmap(inode,0)))) {
 		retval = -EACCES;
 		goto exec_error2;
 	}
@@ -323,6 +323,8 @@ restart_interp:
 		if (current->sigaction[i].sa_handler != SIG_IGN)
 			current->sigaction[i].sa_handler = NULL;
 	}
+	exit_aio();
+	exit_mmap();
 	for (i=0 ; i<NR_OPEN ; i++)
 		if ((current->close_on_exec>>i)&1)
 			sys_close(i);
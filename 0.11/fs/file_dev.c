@@ -6,6 +6,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 
 #include <linux/sched.h>
 #include <linux/kernel.h>
@@ -16,14 +17,28 @@
 
 int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
 {
-	int left,chars,nr;
+	struct super_block * sb;
+	int left,chars,nr,n,zmask;
 	struct buffer_head * bh;
 
 	if ((left=count)<=0)
 		return 0;
+	sb = get_super(inode->i_dev);
+	zmask = sb ? (1 << sb->s_log_zone_size)-1 : 0;
 	while (left) {
 		if ((nr = bmap(inode,(filp->f_pos)/BLOCK_SIZE))) {
-			if (!(bh=bread(inode->i_dev,nr)))
+/*
+ * The rest of the zone is contiguous: start reading it as well. breada()
+ * takes at most 3 more blocks, so that is done at the start of the zone
+ * and then every 4 blocks into it.
+ */
+			n = zmask - (nr & zmask);
+			if (n && !(nr & zmask & 3))
+				bh = breada(inode->i_dev,nr,nr+1,
+					n>1 ? nr+2 : -1,n>2 ? nr+3 : -1,-1);
+			else
+				bh = bread(inode->i_dev,nr);
+			if (!bh)
 				break;
 		} else
 			bh = NULL;
@@ -32,16 +47,15 @@ int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
 		filp->f_pos += chars;
 		left -= chars;
 		if (bh) {
-			char * p = nr + bh->b_data;
-			while (chars-->0)
-				put_fs_byte(*(p++),buf++);
+			memcpy_tofs(buf,nr + bh->b_data,chars);
+			buf += chars;
 			brelse(bh);
 		} else {
 			while (chars-->0)
 				put_fs_byte(0,buf++);
 		}
 	}
-	inode->i_atime = CURRENT_TIME;
+	update_atime(inode,0);
 	return (count-left)?(count-left):-ERROR;
 }
 
@@ -62,11 +76,28 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
 	else
 		pos = filp->f_pos;
 	while (i<count) {
-		if (!(block = create_block(inode,pos/BLOCK_SIZE)))
+		c = pos % BLOCK_SIZE;
+/* new blocks get their zones later if possible, see delalloc.c */
+		bh = get_delayed(inode,pos/BLOCK_SIZE,&block);
+		if (!bh && !block && !(block = create_block(inode,pos/BLOCK_SIZE)))
 			break;
-		if (!(bh=bread(inode->i_dev,block)))
+/*
+ * If the whole block is overwritten, or none of it is inside the file
+ * yet, there's no point in reading the old contents.
+ */
+		if (bh)
+			/* already uptodate */ ;
+		else if ((!c && count-i >= BLOCK_SIZE) ||
+		    pos-c >= inode->i_size) {
+			if (!(bh=getblk(inode->i_dev,block)))
+				break;
+			if (!bh->b_uptodate) {
+				if (c || count-i < BLOCK_SIZE)
+					memset(bh->b_data,0,BLOCK_SIZE);
+				bh->b_uptodate = 1;
+			}
+		} else if (!(bh=bread(inode->i_dev,block)))
 			break;
-		c = pos % BLOCK_SIZE;
 		p = c + bh->b_data;
 		bh->b_dirt = 1;
 		c = BLOCK_SIZE-c;
@@ -77,8 +108,8 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
 			inode->i_dirt = 1;
 		}
 		i += c;
-		while (c-->0)
-			*(p++) = get_fs_byte(buf++);
+		memcpy_fromfs(p,buf,c);
+		buf += c;
 		brelse(bh);
 	}
 	inode->i_mtime = CURRENT_TIME;
@@ -12,7 +12,25 @@
 #include <linux/mm.h>
 #include <asm/system.h>
 
-struct m_inode inode_table[NR_INODE]={{0,},};
+/*
+ * In-core inodes are found through a hash on (dev, i_num), and the unused
+ * ones (i_count == 0) are kept on a circular LRU list, oldest first, so
+ * that neither iget() nor get_empty_inode() has to scan the table. The
+ * table starts out as inode_table[], and grows a page at a time up to
+ * NR_INODE_MAX inodes when few unused ones are left. Inodes are never
+ * given back, so inode_list can be walked even if we sleep on the way.
+ */
+#define NR_IHASH 131
+#define ihashfn(dev,nr) (((unsigned)((dev)^(nr)))%NR_IHASH)
+
+static struct m_inode inode_table[NR_INODE]={{0,},};
+static struct m_inode * ihash[NR_IHASH];
+static struct m_inode * free_inodes = NULL;
+static struct task_struct * inode_wait = NULL;
+static int nr_inodes = 0;
+static int nr_free_inodes = 0;
+
+struct m_inode * inode_list = NULL;
 
 static void read_inode(struct m_inode * inode);
 static void write_inode(struct m_inode * inode);
@@ -40,17 +58,116 @@ static inline void unlock_inode(struct m_inode * inode)
 	wake_up(&inode->i_wait);
 }
 
+void insert_inode_hash(struct m_inode * inode)
+{
+	struct m_inode ** p = ihash + ihashfn(inode->i_dev,inode->i_num);
+
+	inode->i_hash_next = *p;
+	*p = inode;
+}
+
+static void remove_hash(struct m_inode * inode)
+{
+	struct m_inode ** p;
+
+	if (!inode->i_dev)
+		return;
+	for (p = ihash + ihashfn(inode->i_dev,inode->i_num) ; *p ;
+	     p = &(*p)->i_hash_next)
+		if (*p == inode) {
+			*p = inode->i_hash_next;
+			break;
+		}
+	inode->i_hash_next = NULL;
+}
+
+/*
+ * i_count has dropped to 0. Inodes that are still worth caching go to the
+ * end of the LRU list, the ones that aren't to the front.
+ */
+static void put_free(struct m_inode * inode, int front)
+{
+	if (!free_inodes) {
+		inode->i_free_next = inode->i_free_prev = inode;
+		free_inodes = inode;
+	} else {
+		inode->i_free_next = free_inodes;
+		inode->i_free_prev = free_inodes->i_free_prev;
+		free_inodes->i_free_prev->i_free_next = inode;
+		free_inodes->i_free_prev = inode;
+		if (front)
+			free_inodes = inode;
+	}
+	nr_free_inodes++;
+	wake_up(&inode_wait);
+}
+
+static void remove_free(struct m_inode * inode)
+{
+	if (!inode->i_free_next)
+		return;
+	if (inode->i_free_next == inode)
+		free_inodes = NULL;
+	else {
+		inode->i_free_prev->i_free_next = inode->i_free_next;
+		inode->i_free_next->i_free_prev = inode->i_free_prev;
+		if (free_inodes == inode)
+			free_inodes = inode->i_free_next;
+	}
+	inode->i_free_next = inode->i_free_prev = NULL;
+	nr_free_inodes--;
+}
+
+void clear_inode(struct m_inode * inode)
+{
+	struct m_inode * next = inode->i_free_next;
+	struct m_inode * prev = inode->i_free_prev;
+	struct m_inode * list = inode->i_list;
+
+	remove_hash(inode);
+	dindex_drop(inode);
+	memset(inode,0,sizeof(*inode));
+	inode->i_free_next = next;
+	inode->i_free_prev = prev;
+	inode->i_list = list;
+}
+
+static int grow_inodes(void)
+{
+	struct m_inode * inode;
+	int n;
+
+	if (!nr_inodes) {
+		inode = inode_table;
+		n = NR_INODE;
+	} else {
+		if (nr_inodes >= NR_INODE_MAX)
+			return 0;
+		if (!(inode = (struct m_inode *) get_free_page()))
+			return 0;
+		n = PAGE_SIZE/sizeof(struct m_inode);
+	}
+	nr_inodes += n;
+	for ( ; n-- ; inode++) {
+		inode->i_list = inode_list;
+		inode_list = inode;
+		put_free(inode,1);
+	}
+	return 1;
+}
+
 void invalidate_inodes(int dev)
 {
-	int i;
 	struct m_inode * inode;
 
-	inode = 0+inode_table;
-	for(i=0 ; i<NR_INODE ; i++,inode++) {
+	for (inode = inode_list ; inode ; inode = inode->i_list) {
 		wait_on_inode(inode);
 		if (inode->i_dev == dev) {
 			if (inode->i_count)
 				printk("inode in use on removed disk\n\r");
+			drop_delayed(inode);
+			dindex_drop(inode);
+			remove_hash(inode);
 			inode->i_dev = inode->i_dirt = 0;
 		}
 	}
@@ -58,95 +175,185 @@ void invalidate_inodes(int dev)
 
 void sync_inodes(void)
 {
-	int i;
 	struct m_inode * inode;
 
-	inode = 0+inode_table;
-	for(i=0 ; i<NR_INODE ; i++,inode++) {
+	for (inode = inode_list ; inode ; inode = inode->i_list) {
 		wait_on_inode(inode);
 		if (inode->i_dirt && !inode->i_pipe)
 			write_inode(inode);
 	}
 }
 
-static int _bmap(struct m_inode * inode,int block,int create)
+/*
+ * Indirect tables hold 512 16-bit zone numbers on a v1 filesystem, and
+ * 256 32-bit ones on a v2 filesystem.
+ */
+static inline unsigned long get_entry(struct buffer_head * bh, int nr, int v2)
+{
+	if (v2)
+		return ((unsigned long *) bh->b_data)[nr];
+	return ((unsigned short *) bh->b_data)[nr];
+}
+
+static inline void set_entry(struct buffer_head * bh, int nr, int v2,
+	unsigned long zone)
+{
+	if (v2)
+		((unsigned long *) bh->b_data)[nr] = zone;
+	else
+		((unsigned short *) bh->b_data)[nr] = zone;
+	bh->b_dirt = 1;
+}
+
+/*
+ * The goal for a new zone is the one after its predecessor in the same
+ * table, or after the indirect block holding the table if it is the
+ * first entry: that way a file written sequentially is contiguous.
+ */
+static int goal(struct buffer_head * bh, int nr, int v2, int parent)
+{
+	unsigned long prev;
+
+	if (nr && (prev = get_entry(bh,nr-1,v2)))
+		return prev+1;
+	return parent+1;
+}
+
+/*
+ * Remember the run of consecutive zones starting at entry nr (which is
+ * logical zone 'block'), so that the next lookups in it don't have to
+ * read the indirect blocks again. With new_block() keeping files
+ * contiguous, one extent usually covers a whole indirect block.
+ */
+static void set_extent(struct m_inode * inode, int block,
+	struct buffer_head * bh, int nr, int v2)
+{
+	int n, per = v2 ? 256 : 512;
+
+	for (n = nr+1 ; n < per &&
+	     get_entry(bh,n,v2) == get_entry(bh,n-1,v2)+1 ; n++)
+		/* nothing */ ;
+	inode->i_ext_block = block;
+	inode->i_ext_zone = get_entry(bh,nr,v2);
+	inode->i_ext_len = n - nr;
+}
+
+/*
+ * Map logical zone 'block' of the inode to a zone. i_zone[7] is the
+ * indirect zone, i_zone[8] the double and (v2 only) i_zone[9] the triple
+ * indirect one. Indirect zones only use their first block.
+ */
+static int zmap(struct m_inode * inode,int block,int create,int shift,int v2)
 {
 	struct buffer_head * bh;
-	int i;
+	int i, zone, level, slot, nr, lblock = block;
+	int per = v2 ? 256 : 512, bits = v2 ? 8 : 9;
 
-	if (block<0)
-		panic("_bmap: block<0");
-	if (block >= 7+512+512*512)
-		panic("_bmap: block>big");
+	if (block - inode->i_ext_block < inode->i_ext_len)
+		return inode->i_ext_zone + (block - inode->i_ext_block);
 	if (block<7) {
 		if (create && !inode->i_zone[block])
-			if ((inode->i_zone[block]=new_block(inode->i_dev))) {
+			if ((inode->i_zone[block]=new_block(inode->i_dev,
+			    block ? inode->i_zone[block-1]+1 : 0))) {
 				inode->i_ctime=CURRENT_TIME;
 				inode->i_dirt=1;
 			}
 		return inode->i_zone[block];
 	}
 	block -= 7;
-	if (block<512) {
-		if (create && !inode->i_zone[7])
-			if ((inode->i_zone[7]=new_block(inode->i_dev))) {
-				inode->i_dirt=1;
-				inode->i_ctime=CURRENT_TIME;
-			}
-		if (!inode->i_zone[7])
+	for (level = 1, nr = per ; block >= nr ; level++, nr *= per) {
+		if (level == (v2 ? 3 : 2))
+			panic("_bmap: block>big");
+		block -= nr;
+	}
+	slot = 6+level;
+	if (create && !inode->i_zone[slot])
+		if ((inode->i_zone[slot]=new_block(inode->i_dev,
+		    inode->i_zone[slot-1]+1))) {
+			inode->i_dirt=1;
+			inode->i_ctime=CURRENT_TIME;
+		}
+	zone = inode->i_zone[slot];
+	while (level--) {
+		if (!zone)
 			return 0;
-		if (!(bh = bread(inode->i_dev,inode->i_zone[7])))
+		if (!(bh = bread(inode->i_dev,zone << shift)))
 			return 0;
-		i = ((unsigned short *) (bh->b_data))[block];
+		nr = (block >> (bits*level)) & (per-1);
+		i = get_entry(bh,nr,v2);
 		if (create && !i)
-			if ((i=new_block(inode->i_dev))) {
-				((unsigned short *) (bh->b_data))[block]=i;
-				bh->b_dirt=1;
-			}
+			if ((i=new_block(inode->i_dev,goal(bh,nr,v2,zone))))
+				set_entry(bh,nr,v2,i);
+		if (!level && i)
+			set_extent(inode,lblock,bh,nr,v2);
 		brelse(bh);
-		return i;
+		zone = i;
 	}
-	block -= 512;
-	if (create && !inode->i_zone[8])
-		if ((inode->i_zone[8]=new_block(inode->i_dev))) {
-			inode->i_dirt=1;
-			inode->i_ctime=CURRENT_TIME;
-		}
-	if (!inode->i_zone[8])
-		return 0;
-	if (!(bh=bread(inode->i_dev,inode->i_zone[8])))
-		return 0;
-	i = ((unsigned short *)bh->b_data)[block>>9];
-	if (create && !i)
-		if ((i=new_block(inode->i_dev))) {
-			((unsigned short *) (bh->b_data))[block>>9]=i;
-			bh->b_dirt=1;
-		}
-	brelse(bh);
-	if (!i)
-		return 0;
-	if (!(bh=bread(inode->i_dev,i)))
+	return zone;
+}
+
+/*
+ * A zone is 2^s_log_zone_size blocks, and the blocks of a zone are
+ * contiguous on the disk. Everything above the mapping (ie file
+ * offsets) is in blocks, the tables in the inode are in zones.
+ */
+int _bmap(struct m_inode * inode,int block,int create)
+{
+	struct super_block * sb;
+	int shift, zone;
+
+	if (block<0)
+		panic("_bmap: block<0");
+	if (!(sb = get_super(inode->i_dev)))
+		panic("_bmap: no super-block");
+	shift = sb->s_log_zone_size;
+	if (!(zone = zmap(inode,block >> shift,create,shift,sb->s_version==2)))
 		return 0;
-	i = ((unsigned short *)bh->b_data)[block&511];
-	if (create && !i)
-		if ((i=new_block(inode->i_dev))) {
-			((unsigned short *) (bh->b_data))[block&511]=i;
-			bh->b_dirt=1;
-		}
-	brelse(bh);
-	return i;
+	return (zone << shift) + (block & ((1 << shift)-1));
 }
 
 int bmap(struct m_inode * inode,int block)
 {
+	if (inode->i_delayed)
+		flush_delayed(inode);
 	return _bmap(inode,block,0);
 }
 
 int create_block(struct m_inode * inode, int block)
 {
+	if (inode->i_delayed)
+		flush_delayed(inode);
 	return _bmap(inode,block,1);
 }
 		
+/*
+ * The inode has been read: update i_atime as the mount flags of its
+ * filesystem say. Without flags the inode is only marked dirty if
+ * 'dirt' is set: file reads and opens never did that, and that keeps
+ * them from writing inodes back just for the access time. v1 inodes
+ * have no atime on disk, so there is never anything to write back.
+ */
+void update_atime(struct m_inode * inode, int dirt)
+{
+	struct super_block * sb;
+	unsigned long now = CURRENT_TIME;
+
+	if (!inode->i_dev || !(sb = get_super(inode->i_dev))) {
+		inode->i_atime = now;
+		return;
+	}
+	if (sb->s_flags & MS_NOATIME)
+		return;
+	if ((sb->s_flags & MS_RELATIME) && inode->i_atime > inode->i_mtime &&
+	    inode->i_atime > inode->i_ctime && now - inode->i_atime < 24*60*60)
+		return;
+	if (inode->i_atime != now) {
+		inode->i_atime = now;
+		if (sb->s_version == 2 && (dirt || (sb->s_flags & MS_RELATIME)))
+			inode->i_dirt = 1;
+	}
+}
+
 void iput(struct m_inode * inode)
 {
 	if (!inode)
@@ -158,14 +365,17 @@ void iput(struct m_inode * inode)
 		wake_up(&inode->i_wait);
 		if (--inode->i_count)
 			return;
+		free_pipe_buffers(inode);
 		free_page(inode->i_size);
 		inode->i_count=0;
 		inode->i_dirt=0;
 		inode->i_pipe=0;
+		put_free(inode,1);
 		return;
 	}
 	if (!inode->i_dev) {
-		inode->i_count--;
+		if (!--inode->i_count)
+			put_free(inode,1);
 		return;
 	}
 	if (S_ISBLK(inode->i_mode)) {
@@ -178,49 +388,60 @@ repeat:
 		return;
 	}
 	if (!inode->i_nlinks) {
+		if (defer_truncate(inode))
+			return;
 		truncate(inode);
 		free_inode(inode);
+		put_free(inode,1);
 		return;
 	}
+	if (inode->i_delayed) {
+		flush_delayed(inode);	/* we can sleep - so do again */
+		goto repeat;
+	}
 	if (inode->i_dirt) {
 		write_inode(inode);	/* we can sleep - so do again */
 		wait_on_inode(inode);
 		goto repeat;
 	}
 	inode->i_count--;
+	put_free(inode,0);
 	return;
 }
 
+/*
+ * Take the least recently used clean inode (or, failing that, the least
+ * recently used one, which is written out first). The table is grown
+ * while less than a quarter of it is unused: that keeps a reasonable
+ * number of inodes cached without writing them out all the time. If
+ * it can't grow any more and everything is in use, we wait for an iput().
+ */
 struct m_inode * get_empty_inode(void)
 {
 	struct m_inode * inode;
-	static struct m_inode * last_inode = inode_table;
 	int i;
 
-	do {
-		inode = NULL;
-		for (i = NR_INODE; i ; i--) {
-			if (++last_inode >= inode_table + NR_INODE)
-				last_inode = inode_table;
-			if (!last_inode->i_count) {
-				inode = last_inode;
-				if (!inode->i_dirt && !inode->i_lock)
-					break;
-			}
-		}
-		if (!inode) {
-			for (i=0 ; i<NR_INODE ; i++)
-				printk("%04x: %6d\t",inode_table[i].i_dev,
-					inode_table[i].i_num);
-			panic("No free inodes in mem");
-		}
+repeat:
+	if (nr_free_inodes <= nr_inodes/4 && grow_inodes())
+		goto repeat;
+	if (!(inode = free_inodes)) {
+		sleep_on(&inode_wait);
+		goto repeat;
+	}
+	for (i = nr_free_inodes ; i ; i--,inode = inode->i_free_next)
+		if (!inode->i_dirt && !inode->i_lock)
+			break;
+	if (!i)
+		inode = free_inodes;
+	wait_on_inode(inode);
+	while (inode->i_dirt) {
+		write_inode(inode);
 		wait_on_inode(inode);
-		while (inode->i_dirt) {
-			write_inode(inode);
-			wait_on_inode(inode);
-		}
-	} while (inode->i_count);
-	memset(inode,0,sizeof(*inode));
+	}
+	if (inode->i_count)		/* somebody iget() it while we slept */
+		goto repeat;
+	remove_free(inode);
+	clear_inode(inode);
 	inode->i_count = 1;
 	return inode;
 }
@@ -232,7 +453,7 @@ struct m_inode * get_pipe_inode(void)
 	if (!(inode = get_empty_inode()))
 		return NULL;
 	if (!(inode->i_size=get_free_page())) {
-		inode->i_count = 0;
+		iput(inode);
 		return NULL;
 	}
 	inode->i_count = 2;	/* sum of readers/writers */
@@ -243,78 +464,155 @@ struct m_inode * get_pipe_inode(void)
 
 struct m_inode * iget(int dev,int nr)
 {
-	struct m_inode * inode, * empty;
+	struct m_inode * inode, * empty = NULL;
 
 	if (!dev)
 		panic("iget with dev==0");
-	empty = get_empty_inode();
-	inode = inode_table;
-	while (inode < NR_INODE+inode_table) {
-		if (inode->i_dev != dev || inode->i_num != nr) {
-			inode++;
-			continue;
-		}
-		wait_on_inode(inode);
-		if (inode->i_dev != dev || inode->i_num != nr) {
-			inode = inode_table;
-			continue;
-		}
-		inode->i_count++;
-		if (inode->i_mount) {
-			int i;
-
-			for (i = 0 ; i<NR_SUPER ; i++)
-				if (super_block[i].s_imount==inode)
-					break;
-			if (i >= NR_SUPER) {
-				printk("Mounted inode hasn't got sb\n");
-				if (empty)
-					iput(empty);
-				return inode;
-			}
-			iput(inode);
-			dev = super_block[i].s_dev;
-			nr = ROOT_INO;
-			inode = inode_table;
-			continue;
+repeat:
+	for (inode = ihash[ihashfn(dev,nr)] ; inode ; inode = inode->i_hash_next)
+		if (inode->i_dev == dev && inode->i_num == nr)
+			break;
+	if (!inode) {
+		if (!empty) {
+			if (!(empty = get_empty_inode()))
+				return NULL;
+			goto repeat;		/* we may have slept */
 		}
-		if (empty)
-			iput(empty);
+		inode = empty;
+		inode->i_dev = dev;
+		inode->i_num = nr;
+		insert_inode_hash(inode);
+		read_inode(inode);
 		return inode;
 	}
-	if (!empty)
-		return (NULL);
-	inode=empty;
-	inode->i_dev = dev;
-	inode->i_num = nr;
-	read_inode(inode);
+	wait_on_inode(inode);
+	if (inode->i_dev != dev || inode->i_num != nr)
+		goto repeat;
+	remove_free(inode);
+	inode->i_count++;
+	if (inode->i_mount) {
+		int i;
+
+		for (i = 0 ; i<NR_SUPER ; i++)
+			if (super_block[i].s_imount==inode)
+				break;
+		if (i >= NR_SUPER) {
+			printk("Mounted inode hasn't got sb\n");
+			if (empty)
+				iput(empty);
+			return inode;
+		}
+		iput(inode);
+		dev = super_block[i].s_dev;
+		nr = ROOT_INO;
+		goto repeat;
+	}
+	if (empty)
+		iput(empty);
 	return inode;
 }
 
+/*
+ * Inode 'nr' is entry 'nr-1' in the inode table, which starts after the
+ * bitmaps. v1 inodes are 32 bytes, v2 inodes 64.
+ */
+static int inode_block(struct super_block * sb, int nr)
+{
+	return 2 + sb->s_imap_blocks + sb->s_zmap_blocks +
+		(nr-1)/(sb->s_version==2 ? V2_INODES_PER_BLOCK : INODES_PER_BLOCK);
+}
+
 static void read_inode(struct m_inode * inode)
 {
 	struct super_block * sb;
 	struct buffer_head * bh;
-	int block;
+	struct d_inode * d;
+	struct d2_inode * d2;
+	int i;
 
 	lock_inode(inode);
 	if (!(sb=get_super(inode->i_dev)))
 		panic("trying to read inode without dev");
-	block = 2 + sb->s_imap_blocks + sb->s_zmap_blocks +
-		(inode->i_num-1)/INODES_PER_BLOCK;
-	if (!(bh=bread(inode->i_dev,block)))
+	if (!(bh=bread(inode->i_dev,inode_block(sb,inode->i_num))))
 		panic("unable to read i-node block");
-	*(struct d_inode *)inode =
-		((struct d_inode *)bh->b_data)
-			[(inode->i_num-1)%INODES_PER_BLOCK];
+	if (sb->s_version == 2) {
+		d2 = (struct d2_inode *) bh->b_data +
+			(inode->i_num-1)%V2_INODES_PER_BLOCK;
+		inode->i_mode = d2->i_mode;
+		inode->i_nlinks = d2->i_nlinks;
+		inode->i_uid = d2->i_uid;
+		inode->i_gid = d2->i_gid;
+		inode->i_size = d2->i_size;
+		inode->i_atime = d2->i_atime;
+		inode->i_mtime = d2->i_mtime;
+		inode->i_ctime = d2->i_ctime;
+		for (i=0 ; i<10 ; i++)
+			inode->i_zone[i] = d2->i_zone[i];
+	} else {
+		d = (struct d_inode *) bh->b_data +
+			(inode->i_num-1)%INODES_PER_BLOCK;
+		inode->i_mode = d->i_mode;
+		inode->i_uid = d->i_uid;
+		inode->i_size = d->i_size;
+		inode->i_atime = inode->i_mtime = inode->i_ctime = d->i_time;
+		inode->i_gid = d->i_gid;
+		inode->i_nlinks = d->i_nlinks;
+		for (i=0 ; i<9 ; i++)
+			inode->i_zone[i] = d->i_zone[i];
+		inode->i_zone[9] = 0;
+	}
 	brelse(bh);
 	unlock_inode(inode);
 }
 
+/*
+ * Copy an in-core inode into the inode-table block it lives in.
+ */
+static void copy_inode(struct super_block * sb, struct m_inode * inode,
+	struct buffer_head * bh)
+{
+	struct d_inode * d;
+	struct d2_inode * d2;
+	int i;
+
+	if (sb->s_version == 2) {
+		d2 = (struct d2_inode *) bh->b_data +
+			(inode->i_num-1)%V2_INODES_PER_BLOCK;
+		d2->i_mode = inode->i_mode;
+		d2->i_nlinks = inode->i_nlinks;
+		d2->i_uid = inode->i_uid;
+		d2->i_gid = inode->i_gid;
+		d2->i_size = inode->i_size;
+		d2->i_atime = inode->i_atime;
+		d2->i_mtime = inode->i_mtime;
+		d2->i_ctime = inode->i_ctime;
+		for (i=0 ; i<10 ; i++)
+			d2->i_zone[i] = inode->i_zone[i];
+	} else {
+		d = (struct d_inode *) bh->b_data +
+			(inode->i_num-1)%INODES_PER_BLOCK;
+		d->i_mode = inode->i_mode;
+		d->i_uid = inode->i_uid;
+		d->i_size = inode->i_size;
+		d->i_time = inode->i_mtime;
+		d->i_gid = inode->i_gid;
+		d->i_nlinks = inode->i_nlinks;
+		for (i=0 ; i<9 ; i++)
+			d->i_zone[i] = inode->i_zone[i];
+	}
+	bh->b_dirt=1;
+	inode->i_dirt=0;
+}
+
+/*
+ * Write an inode, and every other dirty inode in the same inode-table
+ * block while we have it: sync_inodes() then updates each block once.
+ */
 static void write_inode(struct m_inode * inode)
 {
 	struct super_block * sb;
 	struct buffer_head * bh;
+	struct m_inode * tmp;
 	int block;
 
 	lock_inode(inode);
@@ -324,15 +622,15 @@ static void write_inode(struct m_inode * inode)
 	}
 	if (!(sb=get_super(inode->i_dev)))
 		panic("trying to write inode without device");
-	block = 2 + sb->s_imap_blocks + sb->s_zmap_blocks +
-		(inode->i_num-1)/INODES_PER_BLOCK;
+	block = inode_block(sb,inode->i_num);
 	if (!(bh=bread(inode->i_dev,block)))
 		panic("unable to read i-node block");
-	((struct d_inode *)bh->b_data)
-		[(inode->i_num-1)%INODES_PER_BLOCK] =
-			*(struct d_inode *)inode;
-	bh->b_dirt=1;
-	inode->i_dirt=0;
+	copy_inode(sb,inode,bh);
+	for (tmp = inode_list ; tmp ; tmp = tmp->i_list)
+		if (tmp->i_dirt && !tmp->i_lock && !tmp->i_pipe &&
+		    tmp->i_dev == inode->i_dev &&
+		    inode_block(sb,tmp->i_num) == block)
+			copy_inode(sb,tmp,bh);
 	brelse(bh);
 	unlock_inode(inode);
 }
@@ -11,6 +11,7 @@
 #include <linux/sched.h>
 
 extern int tty_ioctl(int dev, int cmd, int arg);
+extern int loop_ioctl(int dev, int cmd, int arg);
 
 typedef int (*ioctl_ptr)(int dev,int cmd,int arg);
 
@@ -24,7 +25,8 @@ static ioctl_ptr ioctl_table[]={
 	tty_ioctl,	/* /dev/ttyx */
 	tty_ioctl,	/* /dev/tty */
 	NULL,		/* /dev/lp */
-	NULL};		/* named pipes */
+	NULL,		/* named pipes */
+	loop_ioctl};	/* /dev/loop */
 	
 
 int sys_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg)
@@ -87,12 +87,17 @@ static int match(int len,const char * name,struct dir_entry * de)
  *
  * This also takes care of the few special cases due to '..'-traversal
  * over a pseudo-root and a mount point.
+ *
+ * Large directories are looked up through their index (dirindex.c),
+ * which only gives candidates: they are checked just the same. If
+ * 'res_nr' isn't NULL, the entry number is returned in it.
  */
 static struct buffer_head * find_entry(struct m_inode ** dir,
-	const char * name, int namelen, struct dir_entry ** res_dir)
+	const char * name, int namelen, struct dir_entry ** res_dir,
+	int * res_nr)
 {
-	int entries;
-	int block,i;
+	int entries, nr[8];
+	int block,i,n;
 	struct buffer_head * bh;
 	struct dir_entry * de;
 	struct super_block * sb;
@@ -124,7 +129,25 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
 			}
 		}
 	}
-	if (!(block = (*dir)->i_zone[0]))
+	if ((n = dindex_find(*dir,name,namelen,nr,8)) >= 0) {
+		for (i=0 ; i<n ; i++) {
+			if (nr[i] >= entries ||
+			    !(block = bmap(*dir,nr[i]/DIR_ENTRIES_PER_BLOCK)) ||
+			    !(bh = bread((*dir)->i_dev,block)))
+				continue;
+			de = nr[i]%DIR_ENTRIES_PER_BLOCK +
+				(struct dir_entry *) bh->b_data;
+			if (match(namelen,name,de)) {
+				*res_dir = de;
+				if (res_nr)
+					*res_nr = nr[i];
+				return bh;
+			}
+			brelse(bh);
+		}
+		return NULL;
+	}
+	if (!(block = bmap(*dir,0)))
 		return NULL;
 	if (!(bh = bread((*dir)->i_dev,block)))
 		return NULL;
@@ -143,6 +166,8 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
 		}
 		if (match(namelen,name,de)) {
 			*res_dir = de;
+			if (res_nr)
+				*res_nr = i;
 			return bh;
 		}
 		de++;
@@ -152,6 +177,86 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
 	return NULL;
 }
 
+/*
+ * Copy a name from user space for the dcache. Returns its length, or
+ * -1 if it is too long or is "." or ".." (which find_entry() handles
+ * specially, and which we don't cache).
+ */
+static int get_name(const char * name, int namelen, char * buf)
+{
+	int i;
+
+#ifdef NO_TRUNCATE
+	if (namelen > NAME_LEN)
+		return -1;
+#else
+	if (namelen > NAME_LEN)
+		namelen = NAME_LEN;
+#endif
+	for (i=0 ; i<namelen ; i++)
+		buf[i] = get_fs_byte(name+i);
+	if (buf[0] == '.' && (namelen == 1 || (namelen == 2 && buf[1] == '.')))
+		return -1;
+	return namelen;
+}
+
+/*
+ *	lookup()
+ *
+ * returns the inode number for a name in a directory, or 0 if there
+ * is no such entry, going through the dcache. 'dir' may be changed, as
+ * for find_entry().
+ */
+static int lookup(struct m_inode ** dir, const char * name, int namelen)
+{
+	char buf[NAME_LEN];
+	struct buffer_head * bh;
+	struct dir_entry * de;
+	unsigned long seq = dcache_seq;
+	int len, inr;
+
+	if (!namelen)
+		return 0;
+	if ((len = get_name(name,namelen,buf)) > 0 &&
+	    (inr = dcache_lookup(*dir,buf,len)) >= 0)
+		return inr;
+	if (!(bh = find_entry(dir,name,namelen,&de,NULL)))
+		inr = 0;
+	else {
+		inr = de->inode;
+		brelse(bh);
+	}
+	if (len > 0 && seq == dcache_seq)
+		dcache_add(*dir,buf,len,inr);
+	return inr;
+}
+
+/*
+ * The entry for 'name' in 'dir' changes: forget what we know about it.
+ */
+static void forget_entry(struct m_inode * dir, const char * name, int namelen)
+{
+	char buf[NAME_LEN];
+	int len;
+
+	if ((len = get_name(name,namelen,buf)) > 0)
+		dcache_remove(dir,buf,len);
+}
+
+/*
+ * Clear entry 'nr' of 'dir' (found with find_entry()), and remember
+ * that it is free.
+ */
+static void remove_entry(struct m_inode * dir, struct buffer_head * bh,
+	struct dir_entry * de, int nr)
+{
+	dindex_remove(dir,de,nr);
+	de->inode = 0;
+	bh->b_dirt = 1;
+	if (nr < dir->i_dir_free)
+		dir->i_dir_free = nr;
+}
+
 /*
  *	add_entry()
  *
@@ -161,11 +266,14 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
  * NOTE!! The inode part of 'de' is left at 0 - which means you
  * may not sleep between calling this and putting something into
  * the entry, as someone else might have used it while you slept.
+ *
+ * The search starts at dir->i_dir_free: all entries before it are
+ * known to be in use.
  */
 static struct buffer_head * add_entry(struct m_inode * dir,
 	const char * name, int namelen, struct dir_entry ** res_dir)
 {
-	int block,i;
+	int block,i,start;
 	struct buffer_head * bh;
 	struct dir_entry * de;
 
@@ -179,24 +287,22 @@ static struct buffer_head * add_entry(struct m_inode * dir,
 #endif
 	if (!namelen)
 		return NULL;
-	if (!(block = dir->i_zone[0]))
-		return NULL;
-	if (!(bh = bread(dir->i_dev,block)))
-		return NULL;
-	i = 0;
-	de = (struct dir_entry *) bh->b_data;
+	i = start = dir->i_dir_free;
+	bh = NULL;
+	de = NULL;
 	while (1) {
-		if ((char *)de >= BLOCK_SIZE+bh->b_data) {
+		if (!bh || (char *)de >= BLOCK_SIZE+bh->b_data) {
 			brelse(bh);
 			bh = NULL;
 			block = create_block(dir,i/DIR_ENTRIES_PER_BLOCK);
 			if (!block)
 				return NULL;
 			if (!(bh = bread(dir->i_dev,block))) {
-				i += DIR_ENTRIES_PER_BLOCK;
+				i = (i/DIR_ENTRIES_PER_BLOCK+1)*DIR_ENTRIES_PER_BLOCK;
 				continue;
 			}
-			de = (struct dir_entry *) bh->b_data;
+			de = i%DIR_ENTRIES_PER_BLOCK +
+				(struct dir_entry *) bh->b_data;
 		}
 		if (i*sizeof(struct dir_entry) >= dir->i_size) {
 			de->inode=0;
@@ -209,6 +315,10 @@ static struct buffer_head * add_entry(struct m_inode * dir,
 			for (i=0; i < NAME_LEN ; i++)
 				de->name[i]=(i<namelen)?get_fs_byte(name+i):0;
 			bh->b_dirt = 1;
+			forget_entry(dir,name,namelen);
+			dindex_add(dir,de,i);
+			if (dir->i_dir_free == start)
+				dir->i_dir_free = i+1;
 			*res_dir = de;
 			return bh;
 		}
@@ -230,9 +340,7 @@ static struct m_inode * get_dir(const char * pathname)
 	char c;
 	const char * thisname;
 	struct m_inode * inode;
-	struct buffer_head * bh;
 	int namelen,inr,idev;
-	struct dir_entry * de;
 
 	if (!current->root || !current->root->i_count)
 		panic("No root inode");
@@ -256,13 +364,11 @@ static struct m_inode * get_dir(const char * pathname)
 			/* nothing */ ;
 		if (!c)
 			return inode;
-		if (!(bh = find_entry(&inode,thisname,namelen,&de))) {
+		if (!(inr = lookup(&inode,thisname,namelen))) {
 			iput(inode);
 			return NULL;
 		}
-		inr = de->inode;
 		idev = inode->i_dev;
-		brelse(bh);
 		iput(inode);
 		if (!(inode = iget(idev,inr)))
 			return NULL;
@@ -305,27 +411,20 @@ struct m_inode * namei(const char * pathname)
 	const char * basename;
 	int inr,dev,namelen;
 	struct m_inode * dir;
-	struct buffer_head * bh;
-	struct dir_entry * de;
 
 	if (!(dir = dir_namei(pathname,&namelen,&basename)))
 		return NULL;
 	if (!namelen)			/* special case: '/usr/' etc */
 		return dir;
-	bh = find_entry(&dir,basename,namelen,&de);
-	if (!bh) {
+	if (!(inr = lookup(&dir,basename,namelen))) {
 		iput(dir);
 		return NULL;
 	}
-	inr = de->inode;
 	dev = dir->i_dev;
-	brelse(bh);
 	iput(dir);
 	dir=iget(dev,inr);
-	if (dir) {
-		dir->i_atime=CURRENT_TIME;
-		dir->i_dirt=1;
-	}
+	if (dir)
+		update_atime(dir,1);
 	return dir;
 }
 
@@ -357,8 +456,7 @@ int open_namei(const char * pathname, int flag, int mode,
 		iput(dir);
 		return -EISDIR;
 	}
-	bh = find_entry(&dir,basename,namelen,&de);
-	if (!bh) {
+	if (!(inr = lookup(&dir,basename,namelen))) {
 		if (!(flag & O_CREAT)) {
 			iput(dir);
 			return -ENOENT;
@@ -389,9 +487,7 @@ int open_namei(const char * pathname, int flag, int mode,
 		*res_inode = inode;
 		return 0;
 	}
-	inr = de->inode;
 	dev = dir->i_dev;
-	brelse(bh);
 	iput(dir);
 	if (flag & O_EXCL)
 		return -EEXIST;
@@ -402,7 +498,7 @@ int open_namei(const char * pathname, int flag, int mode,
 		iput(inode);
 		return -EPERM;
 	}
-	inode->i_atime = CURRENT_TIME;
+	update_atime(inode,0);
 	if (flag & O_TRUNC)
 		truncate(inode);
 	*res_inode = inode;
@@ -429,9 +525,7 @@ int sys_mknod(const char * filename, int mode, int dev)
 		iput(dir);
 		return -EPERM;
 	}
-	bh = find_entry(&dir,basename,namelen,&de);
-	if (bh) {
-		brelse(bh);
+	if (lookup(&dir,basename,namelen)) {
 		iput(dir);
 		return -EEXIST;
 	}
@@ -480,9 +574,7 @@ int sys_mkdir(const char * pathname, int mode)
 		iput(dir);
 		return -EPERM;
 	}
-	bh = find_entry(&dir,basename,namelen,&de);
-	if (bh) {
-		brelse(bh);
+	if (lookup(&dir,basename,namelen)) {
 		iput(dir);
 		return -EEXIST;
 	}
@@ -494,14 +586,14 @@ int sys_mkdir(const char * pathname, int mode)
 	inode->i_size = 32;
 	inode->i_dirt = 1;
 	inode->i_mtime = inode->i_atime = CURRENT_TIME;
-	if (!(inode->i_zone[0]=new_block(inode->i_dev))) {
+	if (!(inode->i_zone[0]=new_block(inode->i_dev,0))) {
 		iput(dir);
 		inode->i_nlinks--;
 		iput(inode);
 		return -ENOSPC;
 	}
 	inode->i_dirt = 1;
-	if (!(dir_block=bread(inode->i_dev,inode->i_zone[0]))) {
+	if (!(dir_block=bread(inode->i_dev,bmap(inode,0)))) {
 		iput(dir);
 		free_block(inode->i_dev,inode->i_zone[0]);
 		inode->i_nlinks--;
@@ -548,8 +640,8 @@ static int empty_dir(struct m_inode * inode)
 	struct dir_entry * de;
 
 	len = inode->i_size / sizeof (struct dir_entry);
-	if (len<2 || !inode->i_zone[0] ||
-	    !(bh=bread(inode->i_dev,inode->i_zone[0]))) {
+	if (len<2 || !(block=bmap(inode,0)) ||
+	    !(bh=bread(inode->i_dev,block))) {
 	    	printk("warning - bad directory on dev %04x\n",inode->i_dev);
 		return 0;
 	}
@@ -587,7 +679,7 @@ static int empty_dir(struct m_inode * inode)
 int sys_rmdir(const char * name)
 {
 	const char * basename;
-	int namelen;
+	int namelen,nr;
 	struct m_inode * dir, * inode;
 	struct buffer_head * bh;
 	struct dir_entry * de;
@@ -604,7 +696,7 @@ int sys_rmdir(const char * name)
 		iput(dir);
 		return -EPERM;
 	}
-	bh = find_entry(&dir,basename,namelen,&de);
+	bh = find_entry(&dir,basename,namelen,&de,&nr);
 	if (!bh) {
 		iput(dir);
 		return -ENOENT;
@@ -647,9 +739,10 @@ int sys_rmdir(const char * name)
 	}
 	if (inode->i_nlinks != 2)
 		printk("empty directory has nlink!=2 (%d)",inode->i_nlinks);
-	de->inode = 0;
-	bh->b_dirt = 1;
+	remove_entry(dir,bh,de,nr);
 	brelse(bh);
+	forget_entry(dir,basename,namelen);
+	dcache_remove_dir(inode->i_dev,inode->i_num);
 	inode->i_nlinks=0;
 	inode->i_dirt=1;
 	dir->i_nlinks--;
@@ -663,7 +756,7 @@ int sys_rmdir(const char * name)
 int sys_unlink(const char * name)
 {
 	const char * basename;
-	int namelen;
+	int namelen,nr;
 	struct m_inode * dir, * inode;
 	struct buffer_head * bh;
 	struct dir_entry * de;
@@ -678,7 +771,7 @@ int sys_unlink(const char * name)
 		iput(dir);
 		return -EPERM;
 	}
-	bh = find_entry(&dir,basename,namelen,&de);
+	bh = find_entry(&dir,basename,namelen,&de,&nr);
 	if (!bh) {
 		iput(dir);
 		return -ENOENT;
@@ -707,9 +800,9 @@ int sys_unlink(const char * name)
 			inode->i_dev,inode->i_num,inode->i_nlinks);
 		inode->i_nlinks=1;
 	}
-	de->inode = 0;
-	bh->b_dirt = 1;
+	remove_entry(dir,bh,de,nr);
 	brelse(bh);
+	forget_entry(dir,basename,namelen);
 	inode->i_nlinks--;
 	inode->i_dirt = 1;
 	inode->i_ctime = CURRENT_TIME;
@@ -753,9 +846,7 @@ int sys_link(const char * oldname, const char * newname)
 		iput(oldinode);
 		return -EACCES;
 	}
-	bh = find_entry(&dir,basename,namelen,&de);
-	if (bh) {
-		brelse(bh);
+	if (lookup(&dir,basename,namelen)) {
 		iput(dir);
 		iput(oldinode);
 		return -EEXIST;
@@ -18,7 +18,61 @@
 
 int sys_ustat(int dev, struct ustat * ubuf)
 {
-	return -ENOSYS;
+	struct super_block * sb;
+	int i;
+
+	if (!(sb = get_super(dev)))
+		return -EINVAL;
+	verify_area(ubuf,sizeof(*ubuf));
+	put_fs_long((sb->s_free_zones - sb->s_reserved) << sb->s_log_zone_size,
+		(unsigned long *) &ubuf->f_tfree);
+	put_fs_word(sb->s_free_inodes,(short *) &ubuf->f_tinode);
+	for (i=0 ; i<6 ; i++) {
+		put_fs_byte(0,ubuf->f_fname+i);
+		put_fs_byte(0,ubuf->f_fpack+i);
+	}
+	return 0;
+}
+
+/*
+ * Allocate the zones of a range of a regular file up front, so that the
+ * file can later be written (typically appended to) without the blocks
+ * ending up all over the disk. i_size isn't changed: read() doesn't
+ * look past it, and new_block() has zeroed the zones anyway.
+ */
+int sys_fallocate(unsigned int fd, off_t offset, off_t len)
+{
+	struct file * file;
+	struct m_inode * inode;
+	struct super_block * sb;
+	unsigned long end, max;
+	int block, last;
+
+	if (fd >= NR_OPEN || !(file = current->filp[fd]) ||
+	    (file->f_flags & O_ACCMODE) == O_RDONLY)
+		return -EBADF;
+	inode = file->f_inode;
+	if (!S_ISREG(inode->i_mode))
+		return -ENODEV;
+	if (offset < 0 || len <= 0)
+		return -EINVAL;
+	if (!(sb = get_super(inode->i_dev)))
+		return -ENODEV;
+/* the zones _bmap() can map: direct, indirect, double (and triple) */
+	if (sb->s_version == 2)
+		max = 7+256+256*256+256*256*256;
+	else
+		max = 7+512+512*512;
+	end = (unsigned long) offset + (unsigned long) len - 1;
+	if (end > 0x7fffffff ||
+	    (end >> BLOCK_SIZE_BITS >> sb->s_log_zone_size) >= max)
+		return -EFBIG;
+	block = offset >> BLOCK_SIZE_BITS;
+	last = end >> BLOCK_SIZE_BITS;
+	for ( ; block <= last ; block++)
+		if (!create_block(inode,block))
+			return -ENOSPC;
+	return 0;
 }
 
 int sys_utime(char * filename, struct utimbuf * times)
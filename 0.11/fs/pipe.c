@@ -5,69 +5,393 @@
  */
 
 #include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/splice.h>
 
 #include <linux/sched.h>
+#include <linux/kernel.h>
 #include <linux/mm.h>	/* for get_free_page */
 #include <asm/segment.h>
 
+/*
+ * The data in a pipe is kept in buffers from the buffer cache (see the
+ * PIPE_ macros in fs.h). write() fills buffers of its own, which have
+ * no device; splice() puts the cache buffers of a file in the pipe as
+ * they are, and tee() the same buffers into two pipes. A buffer is only
+ * written to by write_pipe() while it is the last one in the pipe and
+ * nobody else holds it.
+ */
+
+static inline void push_slot(struct m_inode * inode, struct buffer_head * bh,
+	int offset, int len)
+{
+	struct pipe_slot * s = PIPE_SLOT(*inode,PIPE_HEAD(*inode));
+
+	s->bh = bh;
+	s->offset = offset;
+	s->len = len;
+	PIPE_HEAD(*inode)++;
+}
+
+/*
+ * Take up to 'count' bytes from the first slot. The caller gets a
+ * reference to the buffer (to brelse()) and can sleep while copying.
+ */
+static struct buffer_head * pop_slot(struct m_inode * inode, int count,
+	int * offset, int * len)
+{
+	struct pipe_slot * s = PIPE_SLOT(*inode,PIPE_TAIL(*inode));
+	struct buffer_head * bh = s->bh;
+
+	*offset = s->offset;
+	if (count >= s->len) {
+		*len = s->len;
+		PIPE_TAIL(*inode)++;
+	} else {
+		*len = count;
+		s->offset += count;
+		s->len -= count;
+		bh->b_count++;
+	}
+	return bh;
+}
+
+/* returns 0 if the pipe is empty and there are no writers */
+static int wait_data(struct m_inode * inode)
+{
+	while (PIPE_EMPTY(*inode)) {
+		wake_up(&inode->i_wait);
+		if (inode->i_count != 2) /* are there any writers? */
+			return 0;
+		sleep_on(&inode->i_wait);
+	}
+	return 1;
+}
+
+/* returns 0 (and sends SIGPIPE) if the pipe is full and has no readers */
+static int wait_room(struct m_inode * inode)
+{
+	while (PIPE_FULL(*inode)) {
+		wake_up(&inode->i_wait);
+		if (inode->i_count != 2) { /* no readers */
+			current->signal |= (1<<(SIGPIPE-1));
+			return 0;
+		}
+		sleep_on(&inode->i_wait);
+	}
+	return 1;
+}
+
+void free_pipe_buffers(struct m_inode * inode)
+{
+	while (!PIPE_EMPTY(*inode)) {
+		brelse(PIPE_SLOT(*inode,PIPE_TAIL(*inode))->bh);
+		PIPE_TAIL(*inode)++;
+	}
+}
+
 int read_pipe(struct m_inode * inode, char * buf, int count)
 {
-	int chars, size, read = 0;
+	struct buffer_head * bh;
+	int chars, offset, read = 0;
 
 	while (count>0) {
-		while (!(size=PIPE_SIZE(*inode))) {
-			wake_up(&inode->i_wait);
-			if (inode->i_count != 2) /* are there any writers? */
-				return read;
-			sleep_on(&inode->i_wait);
-		}
-		chars = PAGE_SIZE-PIPE_TAIL(*inode);
-		if (chars > count)
-			chars = count;
-		if (chars > size)
-			chars = size;
+		if (!wait_data(inode))
+			return read;
+		bh = pop_slot(inode,count,&offset,&chars);
 		count -= chars;
 		read += chars;
-		size = PIPE_TAIL(*inode);
-		PIPE_TAIL(*inode) += chars;
-		PIPE_TAIL(*inode) &= (PAGE_SIZE-1);
-		while (chars-->0)
-			put_fs_byte(((char *)inode->i_size)[size++],buf++);
+		memcpy_tofs(buf,offset + bh->b_data,chars);
+		brelse(bh);
+		buf += chars;
 	}
 	wake_up(&inode->i_wait);
 	return read;
 }
-	
+
+/* the last buffer, if write_pipe() may add to it */
+static struct pipe_slot * last_slot(struct m_inode * inode)
+{
+	struct pipe_slot * s;
+
+	if (PIPE_EMPTY(*inode))
+		return NULL;
+	s = PIPE_SLOT(*inode,PIPE_HEAD(*inode)-1);
+	if (s->bh->b_dev || s->bh->b_count != 1 ||
+	    s->offset + s->len >= BLOCK_SIZE)
+		return NULL;
+	return s;
+}
+
+/*
+ * The data is copied into the buffer before it is put in the pipe, as
+ * memcpy_fromfs() can sleep. If it was added to the end of the last
+ * buffer, and the readers have taken that one meanwhile, it just goes
+ * into a new slot of the same buffer.
+ */
 int write_pipe(struct m_inode * inode, char * buf, int count)
 {
-	int chars, size, written = 0;
+	struct buffer_head * bh;
+	struct pipe_slot * s;
+	int chars, offset, written = 0;
 
 	while (count>0) {
-		while (!(size=(PAGE_SIZE-1)-PIPE_SIZE(*inode))) {
-			wake_up(&inode->i_wait);
-			if (inode->i_count != 2) { /* no readers */
-				current->signal |= (1<<(SIGPIPE-1));
+		if ((s = last_slot(inode))) {
+			bh = s->bh;
+			bh->b_count++;
+			offset = s->offset + s->len;
+		} else {
+			if (!wait_room(inode))
 				return written?written:-1;
-			}
-			sleep_on(&inode->i_wait);
+			bh = getblk(0,0);	/* not hashed, see buffer.c */
+			bh->b_uptodate = 1;
+			offset = 0;
 		}
-		chars = PAGE_SIZE-PIPE_HEAD(*inode);
+		chars = BLOCK_SIZE-offset;
 		if (chars > count)
 			chars = count;
-		if (chars > size)
-			chars = size;
+		memcpy_fromfs(offset + bh->b_data,buf,chars);
+		if (!PIPE_EMPTY(*inode) &&
+		    (s = PIPE_SLOT(*inode,PIPE_HEAD(*inode)-1))->bh == bh &&
+		    s->offset + s->len == offset) {
+			s->len += chars;
+			brelse(bh);
+		} else {
+			if (!wait_room(inode)) {
+				brelse(bh);
+				return written?written:-1;
+			}
+			push_slot(inode,bh,offset,chars);
+		}
 		count -= chars;
 		written += chars;
-		size = PIPE_HEAD(*inode);
-		PIPE_HEAD(*inode) += chars;
-		PIPE_HEAD(*inode) &= (PAGE_SIZE-1);
-		while (chars-->0)
-			((char *)inode->i_size)[size++]=get_fs_byte(buf++);
+		buf += chars;
+		wake_up(&inode->i_wait);
 	}
 	wake_up(&inode->i_wait);
 	return written;
 }
 
+/* file -> pipe: the buffers of the file go into the pipe */
+static int splice_from_file(struct file * in, off_t * pos,
+	struct m_inode * pipe, int len)
+{
+	struct m_inode * inode = in->f_inode;
+	struct buffer_head * bh;
+	int nr, chars, done = 0;
+
+	while (len > 0 && *pos < inode->i_size) {
+		chars = BLOCK_SIZE - (*pos & (BLOCK_SIZE-1));
+		if (chars > len)
+			chars = len;
+		if (chars > inode->i_size - *pos)
+			chars = inode->i_size - *pos;
+		if ((nr = bmap(inode,*pos >> BLOCK_SIZE_BITS))) {
+			if (!(bh = bread(inode->i_dev,nr)))
+				return done ? done : -EIO;
+		} else {			/* a hole */
+			bh = getblk(0,0);
+			memset(bh->b_data,0,BLOCK_SIZE);
+			bh->b_uptodate = 1;
+		}
+		if (!wait_room(pipe)) {
+			brelse(bh);
+			return done ? done : -EPIPE;
+		}
+		push_slot(pipe,bh,*pos & (BLOCK_SIZE-1),chars);
+		wake_up(&pipe->i_wait);
+		*pos += chars;
+		len -= chars;
+		done += chars;
+	}
+	if (done)
+		update_atime(inode,0);
+	return done;
+}
+
+/*
+ * pipe -> file (or anything else): the output's write routine copies
+ * straight from the buffers. We wait only until there is some data.
+ */
+static int splice_to_file(struct m_inode * pipe, struct file * out,
+	off_t * pos, int len)
+{
+	struct buffer_head * bh;
+	unsigned long old_fs;
+	off_t old_pos = out->f_pos;
+	int offset, chars, n, done = 0;
+
+	while (len > 0 && (!done || !PIPE_EMPTY(*pipe))) {
+		if (!wait_data(pipe))
+			break;
+		bh = pop_slot(pipe,len,&offset,&chars);
+		wake_up(&pipe->i_wait);
+		if (pos)
+			out->f_pos = *pos;
+		old_fs = get_fs();
+		set_fs(get_ds());
+		n = write_file(out,offset + bh->b_data,chars);
+		set_fs(old_fs);
+		brelse(bh);
+		if (pos) {
+			*pos = out->f_pos;
+			out->f_pos = old_pos;
+		}
+		if (n <= 0)
+			return done ? done : n;
+		done += n;
+		len -= n;
+		if (n < chars)
+			break;
+	}
+	return done;
+}
+
+/* pipe -> pipe: the slots are moved over */
+static int splice_pipes(struct m_inode * in, struct m_inode * out, int len)
+{
+	struct buffer_head * bh;
+	int offset, chars, done = 0;
+
+	while (len > 0) {
+		if (PIPE_EMPTY(*in)) {
+			if (done || !wait_data(in))
+				break;
+			continue;
+		}
+		if (PIPE_FULL(*out)) {
+			if (done)
+				break;
+			if (!wait_room(out))
+				return -EPIPE;
+			continue;
+		}
+		bh = pop_slot(in,len,&offset,&chars);
+		push_slot(out,bh,offset,chars);
+		done += chars;
+		len -= chars;
+	}
+	wake_up(&in->i_wait);
+	wake_up(&out->i_wait);
+	return done;
+}
+
+static struct file * get_file(int fd)
+{
+	if (fd < 0 || fd >= NR_OPEN)
+		return NULL;
+	return current->filp[fd];
+}
+
+/* f_mode of a pipe end is 1 or 2, but for anything else it's i_mode */
+static int readable(struct file * file)
+{
+	if (file->f_inode->i_pipe)
+		return file->f_mode & 1;
+	return (file->f_flags & O_ACCMODE) != O_WRONLY;
+}
+
+static int writable(struct file * file)
+{
+	if (file->f_inode->i_pipe)
+		return file->f_mode & 2;
+	return (file->f_flags & O_ACCMODE) != O_RDONLY;
+}
+
+int sys_splice(struct splice_args * args)
+{
+	struct file * in, * out;
+	off_t * off_in, * off_out, pos;
+	int len, retval;
+
+	in = get_file(get_fs_long((unsigned long *) &args->fd_in));
+	out = get_file(get_fs_long((unsigned long *) &args->fd_out));
+	off_in = (off_t *) get_fs_long((unsigned long *) &args->off_in);
+	off_out = (off_t *) get_fs_long((unsigned long *) &args->off_out);
+	len = get_fs_long((unsigned long *) &args->len);
+	if (!in || !out)
+		return -EBADF;
+	if (!readable(in) || !writable(out) ||
+	    get_fs_long((unsigned long *) &args->flags) || len < 0)
+		return -EINVAL;
+	if (in->f_inode->i_pipe && out->f_inode->i_pipe) {
+		if (off_in || off_out || in->f_inode == out->f_inode)
+			return -EINVAL;
+		return splice_pipes(in->f_inode,out->f_inode,len);
+	}
+	if (in->f_inode->i_pipe) {
+		if (off_in)
+			return -ESPIPE;
+		if (!off_out)
+			return splice_to_file(in->f_inode,out,NULL,len);
+		pos = get_fs_long((unsigned long *) off_out);
+		retval = splice_to_file(in->f_inode,out,&pos,len);
+		verify_area(off_out,4);
+		put_fs_long(pos,(unsigned long *) off_out);
+		return retval;
+	}
+	if (!out->f_inode->i_pipe || !S_ISREG(in->f_inode->i_mode))
+		return -EINVAL;
+	if (off_out)
+		return -ESPIPE;
+	if (!off_in)
+		return splice_from_file(in,&in->f_pos,out->f_inode,len);
+	pos = get_fs_long((unsigned long *) off_in);
+	if (pos < 0)
+		return -EINVAL;
+	retval = splice_from_file(in,&pos,out->f_inode,len);
+	verify_area(off_in,4);
+	put_fs_long(pos,(unsigned long *) off_in);
+	return retval;
+}
+
+/*
+ * tee() puts references to the buffers at the front of one pipe into
+ * another, leaving them in the first. Like splice() between pipes, it
+ * only waits until it can do something.
+ */
+int sys_tee(int fd_in, int fd_out, int len)
+{
+	struct file * in, * out;
+	struct pipe_slot * s;
+	unsigned long n;
+	int chars, done = 0;
+
+	if (!(in = get_file(fd_in)) || !(out = get_file(fd_out)))
+		return -EBADF;
+	if (!in->f_inode->i_pipe || !out->f_inode->i_pipe ||
+	    in->f_inode == out->f_inode || !readable(in) ||
+	    !writable(out) || len < 0)
+		return -EINVAL;
+	while (len > 0) {
+		if (PIPE_EMPTY(*in->f_inode)) {
+			if (!wait_data(in->f_inode))
+				return 0;
+			continue;
+		}
+		if (PIPE_FULL(*out->f_inode)) {
+			if (!wait_room(out->f_inode))
+				return -EPIPE;
+			continue;
+		}
+		break;
+	}
+	for (n = PIPE_TAIL(*in->f_inode) ; len > 0 &&
+	     n != PIPE_HEAD(*in->f_inode) && !PIPE_FULL(*out->f_inode) ; n++) {
+		s = PIPE_SLOT(*in->f_inode,n);
+		chars = (len < s->len) ? len : s->len;
+		s->bh->b_count++;
+		push_slot(out->f_inode,s->bh,s->offset,chars);
+		done += chars;
+		len -= chars;
+	}
+	wake_up(&out->f_inode->i_wait);
+	return done;
+}
+
 int sys_pipe(unsigned long * fildes)
 {
 	struct m_inode * inode;
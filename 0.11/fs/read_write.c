@@ -7,6 +7,9 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <fcntl.h>
 
 #include <linux/kernel.h>
 #include <linux/sched.h>
@@ -52,25 +55,15 @@ int sys_lseek(unsigned int fd,off_t offset, int origin)
 	return file->f_pos;
 }
 
-int sys_read(unsigned int fd,char * buf,int count)
+static int read_file(struct file * file, char * buf, int count)
 {
-	struct file * file;
-	struct m_inode * inode;
-
-	// 函数首先对参数有效性进行判断。如果文件句柄值大于程序最多打开文件数 NR_OPEN，或者需要 
-	// 读取的字节计数值小于 0，或者该句柄的文件结构指针为空，则返回出错码并退出。若需读取的 
-	// 字节数 count 等于 0，则返回 0 退出。
-	if (fd>=NR_OPEN || count<0 || !(file=current->filp[fd]))
-		return -EINVAL;
-	if (!count)
-		return 0;
+	struct m_inode * inode = file->f_inode;
 
 	// 然后验证存放数据的缓冲区内存限制。并取文件的 i 节点，用于根据该 i 节点的属性，分别调用 
 	// 相应的读操作函数。若是管道文件，并且是读管道文件模式，则进行读管道操作，若成功则返回 
 	// 读取的字节数，否则返回出错码，退出。如果是字符型文件，则进行读字符设备操作，并返回读 
 	// 取的字符数。如果是块设备文件，则执行块设备读操作，并返回读取的字节数。
 	verify_area(buf,count);
-	inode = file->f_inode;
 	if (inode->i_pipe)
 		return (file->f_mode&1)?read_pipe(inode,buf,count):-EIO;
 	if (S_ISCHR(inode->i_mode))
@@ -92,16 +85,24 @@ int sys_read(unsigned int fd,char * buf,int count)
 	return -EINVAL;
 }
 
-int sys_write(unsigned int fd,char * buf,int count)
+int sys_read(unsigned int fd,char * buf,int count)
 {
 	struct file * file;
-	struct m_inode * inode;
-	
-	if (fd>=NR_OPEN || count <0 || !(file=current->filp[fd]))
+
+	// 函数首先对参数有效性进行判断。如果文件句柄值大于程序最多打开文件数 NR_OPEN，或者需要 
+	// 读取的字节计数值小于 0，或者该句柄的文件结构指针为空，则返回出错码并退出。若需读取的 
+	// 字节数 count 等于 0，则返回 0 退出。
+	if (fd>=NR_OPEN || count<0 || !(file=current->filp[fd]))
 		return -EINVAL;
 	if (!count)
 		return 0;
-	inode=file->f_inode;
+	return read_file(file,buf,count);
+}
+
+int write_file(struct file * file, char * buf, int count)
+{
+	struct m_inode * inode = file->f_inode;
+
 	if (inode->i_pipe)
 		return (file->f_mode&2)?write_pipe(inode,buf,count):-EIO;
 	if (S_ISCHR(inode->i_mode))
@@ -113,3 +114,137 @@ int sys_write(unsigned int fd,char * buf,int count)
 	printk("(Write)inode->i_mode=%06o\n\r",inode->i_mode);
 	return -EINVAL;
 }
+
+int sys_write(unsigned int fd,char * buf,int count)
+{
+	struct file * file;
+	
+	if (fd>=NR_OPEN || count <0 || !(file=current->filp[fd]))
+		return -EINVAL;
+	if (!count)
+		return 0;
+	return write_file(file,buf,count);
+}
+
+/*
+ * readv()/writev() do one read_file()/write_file() per iovec, all in
+ * one system call. They stop at the first short transfer, like a
+ * sequence of read()s or write()s would.
+ */
+static int rw_vector(int rw, unsigned int fd, struct iovec * iov, int iovcnt)
+{
+	struct file * file;
+	char * buf;
+	int count, n, done = 0;
+
+	if (fd>=NR_OPEN || !(file=current->filp[fd]))
+		return -EINVAL;
+	if (iovcnt <= 0 || iovcnt > UIO_MAXIOV)
+		return -EINVAL;
+	for ( ; iovcnt-- > 0 ; iov++) {
+		buf = (char *) get_fs_long((unsigned long *) &iov->iov_base);
+		count = get_fs_long((unsigned long *) &iov->iov_len);
+		if (count < 0)
+			return done ? done : -EINVAL;
+		if (!count)
+			continue;
+		if (rw == READ)
+			n = read_file(file,buf,count);
+		else
+			n = write_file(file,buf,count);
+		if (n <= 0)
+			return done ? done : n;
+		done += n;
+		if (n < count)
+			break;
+	}
+	return done;
+}
+
+int sys_readv(unsigned int fd, struct iovec * iov, int iovcnt)
+{
+	return rw_vector(READ,fd,iov,iovcnt);
+}
+
+int sys_writev(unsigned int fd, struct iovec * iov, int iovcnt)
+{
+	return rw_vector(WRITE,fd,iov,iovcnt);
+}
+
+/*
+ * sendfile() copies from a regular file to any descriptor without going
+ * through user space: the blocks are handed to the write routine of the
+ * output straight from the buffer cache, with fs pointing to the kernel
+ * data segment so that it copies from there.
+ */
+int sys_sendfile(struct sendfile_args * args)
+{
+	static char zeroes[BLOCK_SIZE];
+	struct file * in, * out;
+	struct m_inode * inode;
+	struct buffer_head * bh;
+	unsigned long old_fs;
+	off_t * offset, pos;
+	int count, done, chars, nr, n;
+	char * p;
+
+	out = in = NULL;
+	n = get_fs_long((unsigned long *) &args->out_fd);
+	if (n >= 0 && n < NR_OPEN)
+		out = current->filp[n];
+	n = get_fs_long((unsigned long *) &args->in_fd);
+	if (n >= 0 && n < NR_OPEN)
+		in = current->filp[n];
+	offset = (off_t *) get_fs_long((unsigned long *) &args->offset);
+	count = get_fs_long((unsigned long *) &args->count);
+	if (!in || !out)
+		return -EBADF;
+	if (count < 0)
+		return -EINVAL;
+	inode = in->f_inode;
+	if (!S_ISREG(inode->i_mode) || (in->f_flags & O_ACCMODE) == O_WRONLY)
+		return -EINVAL;
+	pos = offset ? (off_t) get_fs_long((unsigned long *) offset) : in->f_pos;
+	if (pos < 0)
+		return -EINVAL;
+	done = 0;
+	while (count > 0 && pos < inode->i_size) {
+		chars = BLOCK_SIZE - (pos & (BLOCK_SIZE-1));
+		if (chars > count)
+			chars = count;
+		if (chars > inode->i_size - pos)
+			chars = inode->i_size - pos;
+		bh = NULL;
+		if ((nr = bmap(inode,pos >> BLOCK_SIZE_BITS))) {
+			if (!(bh = bread(inode->i_dev,nr))) {
+				n = -EIO;
+				goto out;
+			}
+			p = bh->b_data;
+		} else
+			p = zeroes;		/* a hole */
+		old_fs = get_fs();
+		set_fs(get_ds());
+		n = write_file(out,p + (pos & (BLOCK_SIZE-1)),chars);
+		set_fs(old_fs);
+		brelse(bh);
+		if (n <= 0)
+			goto out;
+		pos += n;
+		done += n;
+		count -= n;
+		if (n < chars)
+			break;
+	}
+	n = 0;
+out:
+	if (offset) {
+		verify_area(offset,4);
+		put_fs_long(pos,(unsigned long *) offset);
+	}
+	else
+		in->f_pos = pos;
+	if (done)
+		update_atime(inode,0);
+	return done ? done : n;
+}
@@ -15,7 +15,6 @@
 static void cp_stat(struct m_inode * inode, struct stat * statbuf)
 {
 	struct stat tmp;
-	int i;
 
 	verify_area(statbuf,sizeof (* statbuf));
 	tmp.st_dev = inode->i_dev;
@@ -29,8 +28,7 @@ static void cp_stat(struct m_inode * inode, struct stat * statbuf)
 	tmp.st_atime = inode->i_atime;
 	tmp.st_mtime = inode->i_mtime;
 	tmp.st_ctime = inode->i_ctime;
-	for (i=0 ; i<sizeof (tmp) ; i++)
-		put_fs_byte(((char *) &tmp)[i],&((char *) statbuf)[i]);
+	memcpy_tofs(statbuf,&tmp,sizeof (tmp));
 }
 
 int sys_stat(char * filename, struct stat * statbuf)
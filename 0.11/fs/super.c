@@ -18,12 +18,6 @@
 int sync_dev(int dev);
 void wait_for_keypress(void);
 
-/* set_bit uses setb, as gas doesn't recognize setc */
-#define set_bit(bitnr,addr) ({ \
-register int __res ; \
-__asm__("bt %2,%3;setb %%al":"=a" (__res):"a" (0),"r" (bitnr),"m" (*(addr))); \
-__res; })
-
 struct super_block super_block[NR_SUPER];
 /* this is initialized in init/main.c */
 int ROOT_DEV = 0;
@@ -88,6 +82,7 @@ void put_super(int dev)
 		return;
 	}
 	lock_super(sb);
+	dcache_remove_dir(dev,0);
 	sb->s_dev = 0;
 	for(i=0;i<I_MAP_SLOTS;i++)
 		brelse(sb->s_imap[i]);
@@ -100,6 +95,7 @@ void put_super(int dev)
 static struct super_block * read_super(int dev)
 {
 	struct super_block * s;
+	struct d2_super_block * d;
 	struct buffer_head * bh;
 	int i,block;
 
@@ -120,16 +116,35 @@ static struct super_block * read_super(int dev)
 	s->s_time = 0;
 	s->s_rd_only = 0;
 	s->s_dirt = 0;
+	s->s_flags = 0;
+	s->s_zcursor = 0;
+	s->s_reserved = 0;
 	lock_super(s);
 	if (!(bh = bread(dev,1))) {
 		s->s_dev=0;
 		free_super(s);
 		return NULL;
 	}
-	*((struct d_super_block *) s) =
-		*((struct d_super_block *) bh->b_data);
+/* the v2 super-block is the v1 one with a 32-bit zone count added */
+	d = (struct d2_super_block *) bh->b_data;
+	s->s_ninodes = d->s_ninodes;
+	s->s_imap_blocks = d->s_imap_blocks;
+	s->s_zmap_blocks = d->s_zmap_blocks;
+	s->s_firstdatazone = d->s_firstdatazone;
+	s->s_log_zone_size = d->s_log_zone_size;
+	s->s_max_size = d->s_max_size;
+	s->s_magic = d->s_magic;
+	if (s->s_magic == SUPER_MAGIC) {
+		s->s_version = 1;
+		s->s_nzones = d->s_nzones;
+	} else if (s->s_magic == SUPER_MAGIC_V2) {
+		s->s_version = 2;
+		s->s_nzones = d->s_zones;
+	} else
+		s->s_version = 0;
 	brelse(bh);
-	if (s->s_magic != SUPER_MAGIC) {
+	if (!s->s_version || s->s_imap_blocks > I_MAP_SLOTS ||
+	    s->s_zmap_blocks > Z_MAP_SLOTS) {
 		s->s_dev = 0;
 		free_super(s);
 		return NULL;
@@ -160,6 +175,7 @@ static struct super_block * read_super(int dev)
 	}
 	s->s_imap[0]->b_data[0] |= 1;
 	s->s_zmap[0]->b_data[0] |= 1;
+	count_free(s);
 	free_super(s);
 	return s;
 }
@@ -184,7 +200,8 @@ int sys_umount(char * dev_name)
 		return -ENOENT;
 	if (!sb->s_imount->i_mount)
 		printk("Mounted inode has i_mount=0\n");
-	for (inode=inode_table+0 ; inode<inode_table+NR_INODE ; inode++)
+	wait_truncates(dev);
+	for (inode=inode_list ; inode ; inode=inode->i_list)
 		if (inode->i_dev==dev && inode->i_count)
 				return -EBUSY;
 	sb->s_imount->i_mount=0;
@@ -233,6 +250,7 @@ int sys_mount(char * dev_name, char * dir_name, int rw_flag)
 		iput(dir_i);
 		return -EPERM;
 	}
+	sb->s_flags = rw_flag & (MS_NOATIME|MS_RELATIME);
 	sb->s_imount=dir_i;
 	dir_i->i_mount=1;
 	dir_i->i_dirt=1;		/* NOTE! we don't iput(dir_i) */
@@ -241,11 +259,11 @@ int sys_mount(char * dev_name, char * dir_name, int rw_flag)
 
 void mount_root(void)
 {
-	int i,free;
+	int i;
 	struct super_block * p;
 	struct m_inode * mi;
 
-	if (32 != sizeof (struct d_inode))
+	if (32 != sizeof (struct d_inode) || 64 != sizeof (struct d2_inode))
 		panic("bad i-node size");
 	for(i=0;i<NR_FILE;i++)
 		file_table[i].f_count=0;
@@ -260,22 +278,13 @@ void mount_root(void)
 	}
 	if (!(p=read_super(ROOT_DEV)))
 		panic("Unable to mount root");
+	p->s_flags = ROOT_MOUNT_FLAGS;
 	if (!(mi=iget(ROOT_DEV,ROOT_INO)))
 		panic("Unable to read root i-node");
 	mi->i_count += 3 ;	/* NOTE! it is logically used 4 times, not 1 */
 	p->s_isup = p->s_imount = mi;
 	current->pwd = mi;
 	current->root = mi;
-	free=0;
-	i=p->s_nzones;
-	while (-- i >= 0)
-		if (!set_bit(i&8191,p->s_zmap[i>>13]->b_data))
-			free++;
-	printk("%d/%d free blocks\n\r",free,p->s_nzones);
-	free=0;
-	i=p->s_ninodes+1;
-	while (-- i >= 0)
-		if (!set_bit(i&8191,p->s_imap[i>>13]->b_data))
-			free++;
-	printk("%d/%d free inodes\n\r",free,p->s_ninodes);
+	printk("%d/%d free blocks\n\r",p->s_free_zones,p->s_nzones);
+	printk("%d/%d free inodes\n\r",p->s_free_inodes,p->s_ninodes);
 }
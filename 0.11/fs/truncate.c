@@ -4,41 +4,50 @@
  *  (C) 1991  Linus Torvalds
  */
 
+#include <errno.h>
+
 #include <linux/sched.h>
+#include <linux/kernel.h>
 
 #include <sys/stat.h>
 
-static void free_ind(int dev,int block)
-{
-	struct buffer_head * bh;
-	unsigned short * p;
-	int i;
-
-	if (!block)
-		return;
-	if ((bh=bread(dev,block))) {
-		p = (unsigned short *) bh->b_data;
-		for (i=0;i<512;i++,p++)
-			if (*p)
-				free_block(dev,*p);
-		brelse(bh);
-	}
-	free_block(dev,block);
-}
+/*
+ * Freeing the zones of a large file means reading all its indirect
+ * blocks, so iput() leaves that to the truncate daemon (a process that
+ * init starts, and which never leaves sys_truncd()) if there is one.
+ * The inode stays allocated, with the daemon's reference, until the
+ * zones are gone.
+ */
+static struct task_struct * truncd_task = NULL;
+static struct task_struct * truncd_wait = NULL;
+static struct task_struct * truncd_done = NULL;
+static struct m_inode * trunc_head = NULL, * trunc_tail = NULL;
+static struct m_inode * trunc_busy = NULL;
 
-static void free_dind(int dev,int block)
+/*
+ * 'block' is a zone: the table is in its first block. Tables hold 512
+ * 16-bit entries on v1, 256 32-bit ones on v2; depth is 1 for the
+ * indirect zone, 2 for the double and 3 for the triple indirect one.
+ */
+static void free_ind(int dev,int block,int shift,int v2,int depth)
 {
 	struct buffer_head * bh;
-	unsigned short * p;
+	unsigned long nr;
 	int i;
 
 	if (!block)
 		return;
-	if ((bh=bread(dev,block))) {
-		p = (unsigned short *) bh->b_data;
-		for (i=0;i<512;i++,p++)
-			if (*p)
-				free_ind(dev,*p);
+	if ((bh=bread(dev,block << shift))) {
+		for (i=0;i<(v2 ? 256 : 512);i++) {
+			nr = v2 ? ((unsigned long *) bh->b_data)[i] :
+				((unsigned short *) bh->b_data)[i];
+			if (!nr)
+				continue;
+			if (depth > 1)
+				free_ind(dev,nr,shift,v2,depth-1);
+			else
+				free_block(dev,nr);
+		}
 		brelse(bh);
 	}
 	free_block(dev,block);
@@ -46,20 +55,86 @@ static void free_dind(int dev,int block)
 
 void truncate(struct m_inode * inode)
 {
-	int i;
+	struct super_block * sb;
+	int i, shift, v2;
 
 	if (!(S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode)))
 		return;
+	drop_delayed(inode);
 	for (i=0;i<7;i++)
 		if (inode->i_zone[i]) {
 			free_block(inode->i_dev,inode->i_zone[i]);
 			inode->i_zone[i]=0;
 		}
-	free_ind(inode->i_dev,inode->i_zone[7]);
-	free_dind(inode->i_dev,inode->i_zone[8]);
-	inode->i_zone[7] = inode->i_zone[8] = 0;
+	if (!(sb = get_super(inode->i_dev)))
+		panic("truncate: no super-block");
+	shift = sb->s_log_zone_size;
+	v2 = sb->s_version == 2;
+	free_ind(inode->i_dev,inode->i_zone[7],shift,v2,1);
+	free_ind(inode->i_dev,inode->i_zone[8],shift,v2,2);
+	free_ind(inode->i_dev,inode->i_zone[9],shift,v2,3);
+	inode->i_zone[7] = inode->i_zone[8] = inode->i_zone[9] = 0;
+	inode->i_ext_len = 0;
 	inode->i_size = 0;
 	inode->i_dirt = 1;
 	inode->i_mtime = inode->i_ctime = CURRENT_TIME;
 }
 
+
+/*
+ * Called by iput() for the last reference to an inode without links.
+ * Returns 1 if the daemon has taken the inode (and the reference).
+ */
+int defer_truncate(struct m_inode * inode)
+{
+	if (!truncd_task || current == truncd_task)
+		return 0;
+	if (!(S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode)))
+		return 0;
+	if (!inode->i_zone[7] && !inode->i_zone[8] && !inode->i_zone[9])
+		return 0;		/* no indirect blocks to read: cheap */
+	inode->i_trunc_next = NULL;
+	if (trunc_tail)
+		trunc_tail->i_trunc_next = inode;
+	else
+		trunc_head = inode;
+	trunc_tail = inode;
+	wake_up(&truncd_wait);
+	return 1;
+}
+
+/* wait until the daemon has finished with all inodes on 'dev' */
+void wait_truncates(int dev)
+{
+	struct m_inode * inode;
+
+repeat:
+	if (trunc_busy && trunc_busy->i_dev == dev) {
+		sleep_on(&truncd_done);
+		goto repeat;
+	}
+	for (inode = trunc_head ; inode ; inode = inode->i_trunc_next)
+		if (inode->i_dev == dev) {
+			sleep_on(&truncd_done);
+			goto repeat;
+		}
+}
+
+int sys_truncd(void)
+{
+	if (!suser())
+		return -EPERM;
+	if (truncd_task)
+		return -EBUSY;
+	truncd_task = current;
+	for (;;) {
+		while (!trunc_head)
+			sleep_on(&truncd_wait);
+		trunc_busy = trunc_head;
+		if (!(trunc_head = trunc_head->i_trunc_next))
+			trunc_tail = NULL;
+		iput(trunc_busy);	/* truncates and frees it */
+		trunc_busy = NULL;
+		wake_up(&truncd_done);
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef _AIO_H
+#define _AIO_H
+
+#include <sys/types.h>
+
+/*
+ * Asynchronous I/O control block. aio_submit() queues the transfer and
+ * returns at once, aio_result stays -EINPROGRESS until aio_wait() has
+ * reaped it, after which it holds the byte count or a negative error.
+ */
+struct aiocb {
+	int aio_fildes;
+	int aio_lio_opcode;	/* LIO_READ or LIO_WRITE */
+	char * aio_buf;
+	off_t aio_offset;
+	int aio_nbytes;
+	int aio_result;
+};
+
+#define LIO_READ	0
+#define LIO_WRITE	1
+
+extern int aio_submit(int nr, struct aiocb ** list);
+extern int aio_wait(int min_nr, int nr, struct aiocb ** list);
+
+#endif
@@ -37,6 +37,50 @@ static inline void put_fs_long(unsigned long val,unsigned long * addr)
 __asm__ ("movl %0,%%fs:%1"::"r" (val),"m" (*addr));
 }
 
+/*
+ * Bulk copies to and from user space: longwords first, then the odd
+ * word and byte at the end. The destination of movs is always %es, so
+ * memcpy_tofs() has to load %fs into it for the duration.
+ */
+static inline void memcpy_fromfs(void * to, const void * from, unsigned long n)
+{
+	int d0,d1,d2;
+
+__asm__ __volatile__("cld\n\t"
+	"rep movsl %%fs:(%%esi),%%es:(%%edi)\n\t"
+	"testb $2,%b6\n\t"
+	"je 1f\n\t"
+	"movsw %%fs:(%%esi),%%es:(%%edi)\n"
+	"1:\ttestb $1,%b6\n\t"
+	"je 2f\n\t"
+	"movsb %%fs:(%%esi),%%es:(%%edi)\n"
+	"2:"
+	:"=&c" (d0),"=&D" (d1),"=&S" (d2)
+	:"0" (n/4),"1" (to),"2" (from),"q" (n)
+	:"memory");
+}
+
+static inline void memcpy_tofs(void * to, const void * from, unsigned long n)
+{
+	int d0,d1,d2;
+
+__asm__ __volatile__("cld\n\t"
+	"push %%es\n\t"
+	"push %%fs\n\t"
+	"pop %%es\n\t"
+	"rep movsl\n\t"
+	"testb $2,%b6\n\t"
+	"je 1f\n\t"
+	"movsw\n"
+	"1:\ttestb $1,%b6\n\t"
+	"je 2f\n\t"
+	"movsb\n"
+	"2:\tpop %%es"
+	:"=&c" (d0),"=&D" (d1),"=&S" (d2)
+	:"0" (n/4),"1" (to),"2" (from),"q" (n)
+	:"memory");
+}
+
 /*
  * Someone who knows GNU asm better than I should double check the followig.
  * It seems to work, but I don't know if I'm doing something subtly wrong.
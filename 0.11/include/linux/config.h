@@ -6,6 +6,13 @@
  * root-device by changing the line ROOT_DEV = XXX in boot/bootsect.s
  */
 
+/*
+ * The mount() flags for the root device: MS_RELATIME keeps reads and
+ * path lookups from writing inodes most of the time, MS_NOATIME all of
+ * the time. 0 updates i_atime on every access.
+ */
+#define ROOT_MOUNT_FLAGS MS_RELATIME
+
 /*
  * define your keyboard here -
  * KBD_FINNISH for Finnish keyboards
@@ -19,14 +19,18 @@
  * 5 - /dev/tty
  * 6 - /dev/lp
  * 7 - unnamed pipes
+ * 8 - /dev/loop
+ * 9 - /dev/vd
+ * 10 - /dev/sd
  */
 
-#define IS_SEEKABLE(x) ((x)>=1 && (x)<=3)
+#define IS_SEEKABLE(x) (((x)>=1 && (x)<=3) || ((x)>=8 && (x)<=10))
 
 #define READ 0
 #define WRITE 1
 #define READA 2		/* read-ahead - don't pause */
 #define WRITEA 3	/* "write-ahead" - silly, but somewhat useful */
+#define FLUSH 4		/* empty the drive's write cache, see ll_rw_flush() */
 
 void buffer_init(long buffer_end);
 
@@ -37,11 +41,13 @@ void buffer_init(long buffer_end);
 #define ROOT_INO 1
 
 #define I_MAP_SLOTS 8
-#define Z_MAP_SLOTS 8
+#define Z_MAP_SLOTS 64
 #define SUPER_MAGIC 0x137F
+#define SUPER_MAGIC_V2 0x2468
 
 #define NR_OPEN 20
-#define NR_INODE 32
+#define NR_INODE 32		/* static, the rest comes from get_free_page() */
+#define NR_INODE_MAX 1024
 #define NR_FILE 64
 #define NR_SUPER 8
 #define NR_HASH 307
@@ -53,15 +59,21 @@ void buffer_init(long buffer_end);
 #endif
 
 #define INODES_PER_BLOCK ((BLOCK_SIZE)/(sizeof (struct d_inode)))
+#define V2_INODES_PER_BLOCK ((BLOCK_SIZE)/(sizeof (struct d2_inode)))
 #define DIR_ENTRIES_PER_BLOCK ((BLOCK_SIZE)/(sizeof (struct dir_entry)))
 
+/*
+ * A pipe is a ring of buffers, in the page at i_size: each slot holds a
+ * reference to a buffer and the part of it that is data. HEAD and TAIL
+ * count slots, and only wrap when they are used as an index.
+ */
+#define PIPE_BUFFERS 8
 #define PIPE_HEAD(inode) ((inode).i_zone[0])
 #define PIPE_TAIL(inode) ((inode).i_zone[1])
-#define PIPE_SIZE(inode) ((PIPE_HEAD(inode)-PIPE_TAIL(inode))&(PAGE_SIZE-1))
+#define PIPE_SLOT(inode,n) ((struct pipe_slot *) (inode).i_size + \
+	((n) & (PIPE_BUFFERS-1)))
 #define PIPE_EMPTY(inode) (PIPE_HEAD(inode)==PIPE_TAIL(inode))
-#define PIPE_FULL(inode) (PIPE_SIZE(inode)==(PAGE_SIZE-1))
-#define INC_PIPE(head) \
-__asm__("incl %0\n\tandl $4095,%0"::"m" (head))
+#define PIPE_FULL(inode) (PIPE_HEAD(inode)-PIPE_TAIL(inode)==PIPE_BUFFERS)
 
 typedef char buffer_block[BLOCK_SIZE];
 
@@ -78,6 +90,9 @@ struct buffer_head {
 	struct buffer_head * b_next;
 	struct buffer_head * b_prev_free;
 	struct buffer_head * b_next_free;
+	struct buffer_head * b_reqnext;	/* next buffer of the same request */
+	struct m_inode * b_inode;	/* delayed block of this inode */
+	struct buffer_head * b_delay_next;
 };
 
 struct d_inode {
@@ -90,15 +105,37 @@ struct d_inode {
 	unsigned short i_zone[9];
 };
 
+/* minix v2: 32-bit zone numbers, and a triple indirect zone */
+struct d2_inode {
+	unsigned short i_mode;
+	unsigned short i_nlinks;
+	unsigned short i_uid;
+	unsigned short i_gid;
+	unsigned long i_size;
+	unsigned long i_atime;
+	unsigned long i_mtime;
+	unsigned long i_ctime;
+	unsigned long i_zone[10];
+};
+
+struct pipe_slot {
+	struct buffer_head * bh;
+	unsigned short offset;
+	unsigned short len;
+};
+
+/*
+ * The in-memory inode holds either kind: read_inode() and write_inode()
+ * convert. v1 inodes have no i_zone[9], and only one time for all three.
+ */
 struct m_inode {
 	unsigned short i_mode;
 	unsigned short i_uid;
 	unsigned long i_size;
 	unsigned long i_mtime;
-	unsigned char i_gid;
-	unsigned char i_nlinks;
-	unsigned short i_zone[9];
-/* these are in memory also */
+	unsigned short i_gid;
+	unsigned short i_nlinks;
+	unsigned long i_zone[10];
 	struct task_struct * i_wait;
 	unsigned long i_atime;
 	unsigned long i_ctime;
@@ -111,6 +148,18 @@ struct m_inode {
 	unsigned char i_mount;
 	unsigned char i_seek;
 	unsigned char i_update;
+/* last extent found through an indirect block, see _bmap() */
+	unsigned long i_ext_block;
+	unsigned long i_ext_zone;
+	unsigned long i_ext_len;
+	struct buffer_head * i_delayed;	/* blocks without zones, delalloc.c */
+	struct dir_index * i_index;	/* large directories, dirindex.c */
+	unsigned long i_dir_free;	/* entries below this are all in use */
+	struct m_inode * i_trunc_next;	/* waiting for the truncate daemon */
+/* these are kept over clear_inode() */
+	struct m_inode * i_hash_next;
+	struct m_inode * i_free_next, * i_free_prev;
+	struct m_inode * i_list;		/* all inodes */
 };
 
 struct file {
@@ -121,9 +170,17 @@ struct file {
 	off_t f_pos;   //文件当前的读写指针位置
 };
 
+/*
+ * mount() flags (the rw_flag argument). With MS_RELATIME, i_atime is
+ * only updated if it isn't newer than i_mtime and i_ctime, or is more
+ * than a day old: enough for "has this been read since it changed".
+ */
+#define MS_NOATIME	2
+#define MS_RELATIME	4
+
 struct super_block {
 	unsigned short s_ninodes;
-	unsigned short s_nzones;
+	unsigned long s_nzones;
 	unsigned short s_imap_blocks;
 	unsigned short s_zmap_blocks;
 	unsigned short s_firstdatazone;
@@ -131,8 +188,9 @@ struct super_block {
 	unsigned long s_max_size;
 	unsigned short s_magic;
 /* These are only in memory */
-	struct buffer_head * s_imap[8];
-	struct buffer_head * s_zmap[8];
+	unsigned char s_version;	/* 1 or 2 */
+	struct buffer_head * s_imap[I_MAP_SLOTS];
+	struct buffer_head * s_zmap[Z_MAP_SLOTS];
 	unsigned short s_dev;
 	struct m_inode * s_isup;
 	struct m_inode * s_imount;
@@ -141,6 +199,13 @@ struct super_block {
 	unsigned char s_lock;
 	unsigned char s_rd_only;
 	unsigned char s_dirt;
+	unsigned short s_flags;		/* MS_NOATIME etc, from mount() */
+	unsigned long s_zcursor;	/* where new_block() looks next */
+	unsigned long s_free_inodes;
+	unsigned long s_free_zones;
+	unsigned long s_reserved;	/* zones promised to delayed blocks */
+	unsigned short s_ifree[I_MAP_SLOTS];	/* free bits per map block */
+	unsigned short s_zfree[Z_MAP_SLOTS];
 };
 
 struct d_super_block {
@@ -154,46 +219,89 @@ struct d_super_block {
 	unsigned short s_magic;
 };
 
+struct d2_super_block {
+	unsigned short s_ninodes;
+	unsigned short s_nzones;	/* unused */
+	unsigned short s_imap_blocks;
+	unsigned short s_zmap_blocks;
+	unsigned short s_firstdatazone;
+	unsigned short s_log_zone_size;
+	unsigned long s_max_size;
+	unsigned short s_magic;
+	unsigned short s_state;
+	unsigned long s_zones;
+};
+
 struct dir_entry {
 	unsigned short inode;
 	char name[NAME_LEN];
 };
 
-extern struct m_inode inode_table[NR_INODE];
+extern struct m_inode * inode_list;
 extern struct file file_table[NR_FILE];   //文件表数组
 extern struct super_block super_block[NR_SUPER];
 extern struct buffer_head * start_buffer;
 extern int nr_buffers;
 
 extern void check_disk_change(int dev);
+extern void invalidate_buffers(int dev);
 extern int floppy_change(unsigned int nr);
 extern int ticks_to_floppy_on(unsigned int dev);
 extern void floppy_on(unsigned int dev);
 extern void floppy_off(unsigned int dev);
 extern void truncate(struct m_inode * inode);
+extern int defer_truncate(struct m_inode * inode);
+extern void wait_truncates(int dev);
 extern void sync_inodes(void);
 extern void wait_on(struct m_inode * inode);
 extern int bmap(struct m_inode * inode,int block);
 extern int create_block(struct m_inode * inode,int block);
+extern int _bmap(struct m_inode * inode,int block,int create);
 extern struct m_inode * namei(const char * pathname);
 extern int open_namei(const char * pathname, int flag, int mode,
 	struct m_inode ** res_inode);
 extern void iput(struct m_inode * inode);
+extern void update_atime(struct m_inode * inode, int dirt);
 extern struct m_inode * iget(int dev,int nr);
 extern struct m_inode * get_empty_inode(void);
 extern struct m_inode * get_pipe_inode(void);
+extern void free_pipe_buffers(struct m_inode * inode);
+extern void insert_inode_hash(struct m_inode * inode);
+extern void clear_inode(struct m_inode * inode);
 extern struct buffer_head * get_hash_table(int dev, int block);
 extern struct buffer_head * getblk(int dev, int block);
 extern void ll_rw_block(int rw, struct buffer_head * bh);
+extern void ll_rw_flush(int dev);
+extern void set_blocknr(struct buffer_head * bh, int dev, int block);
+extern struct buffer_head * get_delayed(struct m_inode * inode, int block,
+	int * zone);
+extern void flush_delayed(struct m_inode * inode);
+extern void drop_delayed(struct m_inode * inode);
+extern void flush_all_delayed(int dev);
+extern unsigned long dcache_seq;
+extern int dcache_lookup(struct m_inode * dir, const char * name, int len);
+extern void dcache_add(struct m_inode * dir, const char * name, int len,
+	int ino);
+extern void dcache_remove(struct m_inode * dir, const char * name, int len);
+extern void dcache_remove_dir(int dev, int dir);
+extern int dindex_find(struct m_inode * dir, const char * name, int len,
+	int * nr, int max);
+extern void dindex_add(struct m_inode * dir, struct dir_entry * de, int nr);
+extern void dindex_remove(struct m_inode * dir, struct dir_entry * de, int nr);
+extern void dindex_drop(struct m_inode * dir);
+extern int wait_on_requests(struct buffer_head ** bh, int nr);
 extern void brelse(struct buffer_head * buf);
 extern struct buffer_head * bread(int dev,int block);
 extern void bread_page(unsigned long addr,int dev,int b[4]);
 extern struct buffer_head * breada(int dev,int block,...);
-extern int new_block(int dev);
+extern int new_block(int dev, int goal);
 extern void free_block(int dev, int block);
 extern struct m_inode * new_inode(int dev);
 extern void free_inode(struct m_inode * inode);
+extern void count_free(struct super_block * sb);
 extern int sync_dev(int dev);
+extern void exit_aio(void);
+extern int write_file(struct file * file, char * buf, int count);
 extern struct super_block * get_super(int dev);
 extern int ROOT_DEV;
 
@@ -40,6 +40,12 @@
 #define WIN_SEEK 		0x70
 #define WIN_DIAGNOSE		0x90
 #define WIN_SPECIFY		0x91
+#define WIN_FLUSH		0xE7	/* flush the write cache */
+#define WIN_IDENTIFY		0xEC
+#define WIN_SETFEATURES		0xEF
+
+/* SET FEATURES subcommands */
+#define SETFEATURES_WCACHE	0x02	/* enable write cache */
 
 /* Bits for HD_ERROR */
 #define MARK_ERR	0x01	/* Bad address mark ? */
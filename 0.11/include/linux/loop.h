@@ -0,0 +1,15 @@
+#ifndef _LOOP_H
+#define _LOOP_H
+
+/*
+ * Loop devices (major 8) make a regular file look like a block device,
+ * so that a filesystem image can be mounted directly. The backing file
+ * is bound and released with these ioctls on the loop device.
+ */
+
+#define NR_LOOP		4
+
+#define LOOP_SET_FD	0x4C00	/* arg is an open file descriptor */
+#define LOOP_CLR_FD	0x4C01
+
+#endif
@@ -7,4 +7,29 @@ extern unsigned long get_free_page(void);
 extern unsigned long put_page(unsigned long page,unsigned long address);
 extern void free_page(unsigned long addr);
 
+/*
+ * mmap() areas of a task, in its data space. mmap() puts them between
+ * MMAP_BASE and MMAP_END, above the largest brk() and below the stack.
+ */
+#define NR_MMAP		8
+#define MMAP_BASE	0x2000000
+#define MMAP_END	0x3c00000
+
+struct m_inode;
+struct task_struct;
+
+struct vm_area {
+	unsigned long vm_start, vm_end;	/* vm_end == 0 - free */
+	struct m_inode * vm_inode;	/* NULL - anonymous */
+	unsigned long vm_offset;	/* file offset of vm_start */
+	unsigned short vm_prot;
+	unsigned short vm_flags;
+};
+
+extern struct vm_area * find_vma(unsigned long addr);
+extern void read_vma_page(struct vm_area * vma, unsigned long addr,
+	unsigned long page);
+extern void fork_mmap(struct task_struct * p);
+extern void exit_mmap(void);
+
 #endif
@@ -0,0 +1,46 @@
+#ifndef _PCI_H
+#define _PCI_H
+
+/*
+ * Offsets into the PCI configuration space header, and the few bits
+ * of it that the drivers care about.
+ */
+#define PCI_VENDOR_ID		0x00
+#define PCI_DEVICE_ID		0x02
+#define PCI_COMMAND		0x04
+#define PCI_COMMAND_IO		0x01
+#define PCI_COMMAND_MEMORY	0x02
+#define PCI_COMMAND_MASTER	0x04
+#define PCI_CLASS_REVISION	0x08
+#define PCI_HEADER_TYPE		0x0e
+#define PCI_BASE_ADDRESS_0	0x10
+#define PCI_INTERRUPT_LINE	0x3c
+
+#define PCI_BASE_ADDRESS_SPACE_IO	0x01
+#define PCI_BASE_ADDRESS_IO_MASK	(~0x03UL)
+#define PCI_BASE_ADDRESS_MEM_MASK	(~0x0fUL)
+
+#define NR_PCI		32
+
+struct pci_dev {
+	unsigned char bus, devfn;
+	unsigned short vendor, device;
+	unsigned long class;		/* base class, subclass, prog-if */
+	unsigned char irq;
+};
+
+extern struct pci_dev pci_devices[NR_PCI];
+extern int nr_pci_devices;
+
+extern unsigned long pci_read_config(struct pci_dev * dev, int where);
+extern void pci_write_config(struct pci_dev * dev, int where,
+	unsigned long value);
+extern void pci_set_master(struct pci_dev * dev);
+extern struct pci_dev * pci_find_device(unsigned short vendor,
+	unsigned short device, struct pci_dev * from);
+extern struct pci_dev * pci_find_class(unsigned long class,
+	struct pci_dev * from);
+extern int pci_request_irq(int irq, void (*handler)(void));
+extern void pci_init(void);
+
+#endif
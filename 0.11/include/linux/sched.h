@@ -102,6 +102,7 @@ struct task_struct {
 	struct m_inode * executable;
 	unsigned long close_on_exec;
 	struct file * filp[NR_OPEN];
+	struct vm_area mmap[NR_MMAP];
 /* ldt for this task 0 - zero 1 - cs 2 - ds&ss */
 	struct desc_struct ldt[3];
 /* tss for this task */
@@ -122,6 +123,7 @@ struct task_struct {
 /* math */	0, \
 /* fs info */	-1,0022,NULL,NULL,NULL,0, \
 /* filp */	{NULL,}, \
+/* mmap */	{{0,},}, \
 	{ \
 		{0,0}, \
 /* ldt */	{0x9f,0xc0fa00}, \
@@ -70,6 +70,17 @@ extern int sys_sgetmask();
 extern int sys_ssetmask();
 extern int sys_setreuid();
 extern int sys_setregid();
+extern int sys_aio_submit();
+extern int sys_aio_wait();
+extern int sys_fallocate();
+extern int sys_truncd();
+extern int sys_mmap();
+extern int sys_munmap();
+extern int sys_sendfile();
+extern int sys_splice();
+extern int sys_tee();
+extern int sys_readv();
+extern int sys_writev();
 
 fn_ptr sys_call_table[] = { sys_setup, sys_exit, sys_fork, sys_read,
 sys_write, sys_open, sys_close, sys_waitpid, sys_creat, sys_link,
@@ -83,4 +94,6 @@ sys_getgid, sys_signal, sys_geteuid, sys_getegid, sys_acct, sys_phys,
 sys_lock, sys_ioctl, sys_fcntl, sys_mpx, sys_setpgid, sys_ulimit,
 sys_uname, sys_umask, sys_chroot, sys_ustat, sys_dup2, sys_getppid,
 sys_getpgrp, sys_setsid, sys_sigaction, sys_sgetmask, sys_ssetmask,
-sys_setreuid,sys_setregid };
+sys_setreuid,sys_setregid, sys_aio_submit, sys_aio_wait, sys_fallocate,
+sys_truncd, sys_mmap, sys_munmap,
+sys_sendfile, sys_splice, sys_tee, sys_readv, sys_writev };
@@ -0,0 +1,36 @@
+#ifndef _SYS_MMAN_H
+#define _SYS_MMAN_H
+
+#include <sys/types.h>
+
+#define PROT_NONE	0
+#define PROT_READ	1
+#define PROT_WRITE	2
+#define PROT_EXEC	4
+
+#define MAP_SHARED	1	/* writes go back to the file */
+#define MAP_PRIVATE	2	/* writes are copy-on-write */
+#define MAP_TYPE	0x0f
+#define MAP_FIXED	0x10
+#define MAP_ANONYMOUS	0x20	/* no file, zero-filled */
+
+#define MAP_FAILED	((void *) -1)
+
+/*
+ * mmap() has too many arguments for a system call: the library passes
+ * them in this block.
+ */
+struct mmap_args {
+	void * addr;
+	size_t len;
+	int prot;
+	int flags;
+	int fd;
+	off_t offset;
+};
+
+extern void * mmap(void * addr, size_t len, int prot, int flags,
+	int fd, off_t offset);
+extern int munmap(void * addr, size_t len);
+
+#endif
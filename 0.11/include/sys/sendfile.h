@@ -0,0 +1,21 @@
+#ifndef _SYS_SENDFILE_H
+#define _SYS_SENDFILE_H
+
+#include <sys/types.h>
+
+/*
+ * sendfile() has four arguments, one more than a system call can take:
+ * the library passes them in this block. If offset isn't NULL, the
+ * input is read from *offset (which is updated) and the file position
+ * of in_fd is left alone.
+ */
+struct sendfile_args {
+	int out_fd;
+	int in_fd;
+	off_t * offset;
+	size_t count;
+};
+
+extern int sendfile(int out_fd, int in_fd, off_t * offset, size_t count);
+
+#endif
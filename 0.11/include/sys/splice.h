@@ -0,0 +1,27 @@
+#ifndef _SYS_SPLICE_H
+#define _SYS_SPLICE_H
+
+#include <sys/types.h>
+
+/*
+ * splice() moves data between a pipe and a file (or another pipe)
+ * without copying it through user space; tee() duplicates what is in
+ * one pipe into another without consuming it. splice() has six
+ * arguments, so the library passes them in this block. The offsets
+ * are only for a file side: if one isn't NULL, it is used (and
+ * updated) instead of the file position.
+ */
+struct splice_args {
+	int fd_in;
+	off_t * off_in;
+	int fd_out;
+	off_t * off_out;
+	size_t len;
+	unsigned int flags;	/* none yet, must be 0 */
+};
+
+extern int splice(int fd_in, off_t * off_in, int fd_out, off_t * off_out,
+	size_t len, unsigned int flags);
+extern int tee(int fd_in, int fd_out, size_t len);
+
+#endif
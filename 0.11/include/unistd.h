@@ -129,6 +129,17 @@
 #define __NR_ssetmask	69
 #define __NR_setreuid	70
 #define __NR_setregid	71
+#define __NR_aio_submit	72
+#define __NR_aio_wait	73
+#define __NR_fallocate	74
+#define __NR_truncd	75	/* used only by init, to start the daemon */
+#define __NR_mmap	76
+#define __NR_munmap	77
+#define __NR_sendfile	78
+#define __NR_splice	79
+#define __NR_tee	80
+#define __NR_readv	81
+#define __NR_writev	82
 
 #define _syscall0(type,name) \
   type name(void) \
@@ -246,6 +257,7 @@ int utime(const char * filename, struct utimbuf * times);
 pid_t waitpid(pid_t pid,int * wait_stat,int options);
 pid_t wait(int * wait_stat);
 int write(int fildes, const char * buf, off_t count);
+int fallocate(int fildes, off_t offset, off_t len);
 int dup2(int oldfd, int newfd);
 int getppid(void);
 pid_t getpgrp(void);
@@ -26,6 +26,7 @@ static inline _syscall0(int,fork)
 static inline _syscall0(int,pause)  //系统调用：
 static inline _syscall1(int,setup,void *,BIOS)
 static inline _syscall0(int,sync)
+static inline _syscall0(int,truncd)
 
 #include <linux/tty.h>
 #include <linux/sched.h>
@@ -49,6 +50,10 @@ extern void blk_dev_init(void);
 extern void chr_dev_init(void);
 extern void hd_init(void);
 extern void floppy_init(void);
+extern void loop_init(void);
+extern void pci_init(void);
+extern void vd_init(void);
+extern void sd_init(void);
 extern void mem_init(long start, long end);
 extern long rd_init(long mem_start, int length);
 extern long kernel_mktime(struct tm * tm);
@@ -148,8 +153,12 @@ void main(void)		/* This really IS void, no error here. */
 	time_init();
 	sched_init();
 	buffer_init(buffer_memory_end);
+	pci_init();
 	hd_init();
 	floppy_init();
+	loop_init();
+	vd_init();
+	sd_init();
 	sti();   //开启中断
 
 //	下面过程通过在堆栈中设置的参数，利用中断返回指令启动任务 0 执行。然后在任务 0 中立刻运行 fork() 创建任务 1(又称 init 进程)，并在任务 1 中执行 init() 函数。 对于被新创建的子进程， fork() 将返回 0 值，对于原进程(父进程) 则返回子进程的进程号 pid。
@@ -208,6 +217,14 @@ void init(void)
  下面再创建一个子进程(任务 2)，并在该子进程中运行/etc/rc 文件中的命令。对于被创建的子进程，fork()将返回 0 值，对于原进程(父进程)则返回子进程的进程号 pid。所以第 195-201 行是子进程中执行的代码。该子进程的代码首先把标准输入 stdin 重定向到/etc/rc 文件，然后使用execve()函数运行/bin/sh 程序。该程序从标准输入中读取 rc 文件中的命令，并以解释方式执行之。sh 运行时所携带的参数和环境变量分别由 argv_rc 和 envp_rc 数组给出。
  关闭句柄 0 并立刻打开/etc/rc 文件的作用是把标准输入 stdin 重新定向到/etc/rc 文件。这样通过控制台读操作就可以读取/etc/rc 文件中的内容。由于这里 sh 的运行方式是非交互式的，因此在执行完 rc 文件后就会立刻退出，进程 2 也会随之结束。关于 execve()函数说明请参见 fs/exec.c程序，207 行。函数_exit()退出时的出错码 1-操作未许可;2-文件或目录不存在。*/
 
+	/* the truncate daemon frees the zones of large deleted files */
+	if (!(pid = fork())) {
+		close(0);close(1);close(2);
+		setsid();
+		truncd();
+		_exit(1);
+	}
+
 	if (!(pid = fork()))
 	{
 		close(0);
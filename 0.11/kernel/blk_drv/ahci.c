@@ -0,0 +1,453 @@
+/*
+ *  linux/kernel/blk_drv/ahci.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * ahci.c drives SATA disks behind an AHCI controller (like the ICH9 of
+ * QEMU's q35 machine). Each request is put into a command slot of its
+ * own and taken off the queue, so up to 32 commands can be outstanding:
+ * with native command queueing (READ/WRITE FPDMA QUEUED) the drive
+ * itself decides in which order to do them, and reports each one as it
+ * finishes. Drives without NCQ get READ/WRITE DMA EXT instead, which
+ * the controller hands to the drive one after the other.
+ *
+ * The data goes straight to and from the buffers: one PRD entry for
+ * each buffer of a (merged) request.
+ *
+ * Minors are as for the hd driver: 0 is the whole first disk, 1-4 its
+ * partitions, 5 the second disk etc.
+ */
+
+#include <string.h>
+
+#include <linux/config.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/hdreg.h>
+#include <linux/pci.h>
+#include <asm/system.h>
+#include <asm/io.h>
+
+#define MAJOR_NR 10
+#include "blk.h"
+
+#define NR_SD		2
+#define SD_MAX_SECTORS	32		/* per request after merging */
+#define SD_MAX_PRD	(SD_MAX_SECTORS/2)
+
+/* HBA registers */
+#define HBA_CAP		0x00
+#define HBA_GHC		0x04
+#define HBA_IS		0x08
+#define HBA_PI		0x0c
+
+#define CAP_SNCQ	0x40000000
+#define GHC_AE		0x80000000
+#define GHC_IE		0x00000002
+
+/* port registers, at 0x100 + port*0x80 */
+#define PORT_CLB	0x00
+#define PORT_CLBU	0x04
+#define PORT_FB		0x08
+#define PORT_FBU	0x0c
+#define PORT_IS		0x10
+#define PORT_IE		0x14
+#define PORT_CMD	0x18
+#define PORT_TFD	0x20
+#define PORT_SIG	0x24
+#define PORT_SSTS	0x28
+#define PORT_SERR	0x30
+#define PORT_SACT	0x34
+#define PORT_CI		0x38
+
+#define CMD_ST		0x0001
+#define CMD_FRE		0x0010
+#define CMD_FR		0x4000
+#define CMD_CR		0x8000
+
+#define IS_TFES		0x40000000	/* task file error */
+#define IS_ERRORS	0x7d000000	/* all the fatal ones */
+#define IE_MASK		(IS_ERRORS | 0x0000000f)
+
+#define SIG_ATA		0x00000101
+
+#define FIS_TYPE_H2D	0x27
+
+#define ATA_READ_DMA_EXT	0x25
+#define ATA_WRITE_DMA_EXT	0x35
+#define ATA_READ_FPDMA		0x60
+#define ATA_WRITE_FPDMA		0x61
+#define ATA_FLUSH_EXT		0xEA
+#define ATA_IDENTIFY		0xEC
+
+#define REG(base,reg) (*(volatile unsigned long *) ((base)+(reg)))
+
+struct ahci_cmd_header {
+	unsigned long flags;		/* FIS length, write, nr of PRDs */
+	unsigned long prdbc;
+	unsigned long ctba;
+	unsigned long ctbau;
+	unsigned long reserved[4];
+};
+
+struct ahci_prd {
+	unsigned long dba;
+	unsigned long dbau;
+	unsigned long reserved;
+	unsigned long dbc;		/* byte count - 1 */
+};
+
+struct ahci_cmd_table {
+	unsigned char cfis[64];
+	unsigned char acmd[16];
+	unsigned char reserved[48];
+	struct ahci_prd prd[SD_MAX_PRD];
+};
+
+/* the alignments the controller wants fall out of the layout */
+struct ahci_port_mem {
+	struct ahci_cmd_header cmd_list[32];
+	unsigned char fis[256];
+	struct ahci_cmd_table tbl[32];
+} __attribute__ ((aligned (1024)));
+
+static struct sd_struct {
+	char * port;			/* port registers */
+	struct ahci_port_mem * mem;
+	int ncq;
+	unsigned long depth_mask;	/* slots we may use */
+	unsigned long busy;
+	unsigned long nonq;		/* slot of a non-queued command */
+	unsigned char slot[32];		/* slot -> request */
+} sd_info[NR_SD];
+
+static int NR_SD_DISKS = 0;
+
+static struct sd_part {
+	long start_sect;
+	long nr_sects;
+} sd[5*NR_SD];
+
+static char * abar;
+static struct ahci_port_mem sd_mem[NR_SD];
+static unsigned short sd_identify[256];
+
+/*
+ * The registers are somewhere high up in physical memory, but the
+ * kernel only sees the low 16MB. So we point two page table entries
+ * of the kernel at them, uncached. We use the VGA graphics window at
+ * 0xA0000, which the text console never touches: it is in the hole
+ * between 640kB and 1MB, so neither mem_map nor fork() knows about it.
+ */
+#define AHCI_WINDOW	0xA0000
+
+static char * ahci_map(unsigned long phys)
+{
+	unsigned long addr = AHCI_WINDOW;
+	unsigned long * pte;
+	int i;
+
+	for (i=0 ; i<2 ; i++,addr += 4096) {
+		pte = (unsigned long *) (pg_dir[addr>>22] & 0xfffff000);
+		pte[(addr>>12) & 0x3ff] = ((phys & 0xfffff000) + i*4096) | 0x1b;
+	}
+	__asm__("movl %%eax,%%cr3"::"a" (0));
+	return (char *) AHCI_WINDOW + (phys & 0xfff);
+}
+
+/*
+ * Fill in the command FIS for an LBA48 command. For the queued ones
+ * the sector count goes into the features, and the tag into the count.
+ */
+static void sd_fis(unsigned char * fis, int cmd, unsigned long lba,
+	int count, int tag)
+{
+	memset(fis,0,20);
+	fis[0] = FIS_TYPE_H2D;
+	fis[1] = 0x80;
+	fis[2] = cmd;
+	fis[4] = lba;
+	fis[5] = lba >> 8;
+	fis[6] = lba >> 16;
+	fis[7] = 0x40;
+	fis[8] = lba >> 24;
+	if (cmd == ATA_READ_FPDMA || cmd == ATA_WRITE_FPDMA) {
+		fis[3] = count;
+		fis[11] = count >> 8;
+		fis[12] = tag << 3;
+	} else {
+		fis[12] = count;
+		fis[13] = count >> 8;
+	}
+}
+
+/*
+ * Start as many requests as there are free slots. Interrupts must be
+ * off: this is called both from do_sd_request() and the interrupt
+ * handler.
+ */
+static void sd_start(void)
+{
+	struct sd_struct * s;
+	struct request * req;
+	struct buffer_head * bh;
+	struct ahci_cmd_table * tbl;
+	unsigned long free;
+	int dev, slot, n, cmd;
+
+	INIT_REQUEST;
+	dev = MINOR(CURRENT->dev);
+	s = sd_info + CURRENT_DEV;
+	if (dev >= 5*NR_SD_DISKS ||
+	    CURRENT->sector+CURRENT->nr_sectors > sd[dev].nr_sects) {
+		end_io(dequeue_request(),0);
+		goto repeat;
+	}
+/* a non-queued command can't be mixed with queued ones */
+	if (s->ncq && (s->nonq || (CURRENT->cmd == FLUSH && s->busy)))
+		return;
+	if (!(free = s->depth_mask & ~s->busy))
+		return;			/* wait for a completion */
+	for (slot=0 ; !(free & (1UL<<slot)) ; slot++)
+		/* nothing */ ;
+	req = dequeue_request();
+	tbl = s->mem->tbl + slot;
+	if (req->cmd == FLUSH)
+		cmd = ATA_FLUSH_EXT;
+	else if (req->cmd == WRITE)
+		cmd = s->ncq ? ATA_WRITE_FPDMA : ATA_WRITE_DMA_EXT;
+	else
+		cmd = s->ncq ? ATA_READ_FPDMA : ATA_READ_DMA_EXT;
+	sd_fis(tbl->cfis,cmd,req->sector+sd[dev].start_sect,
+		req->nr_sectors,slot);
+	n = 0;
+	if (!req->bh && req->nr_sectors) {
+		tbl->prd[0].dba = (unsigned long) req->buffer;
+		tbl->prd[0].dbau = 0;
+		tbl->prd[0].dbc = (req->nr_sectors<<9)-1;
+		n = 1;
+	}
+	for (bh = req->bh ; bh ; bh = bh->b_reqnext,n++) {
+		tbl->prd[n].dba = (unsigned long) bh->b_data;
+		tbl->prd[n].dbau = 0;
+		tbl->prd[n].dbc = BLOCK_SIZE-1;
+	}
+	s->mem->cmd_list[slot].flags = 5 | (n<<16) |
+		((req->cmd == WRITE) ? 0x40 : 0);
+	s->mem->cmd_list[slot].prdbc = 0;
+	s->slot[slot] = req - request;
+	s->busy |= 1UL<<slot;
+	if (cmd == ATA_FLUSH_EXT)
+		s->nonq = 1UL<<slot;
+	else if (s->ncq)
+		REG(s->port,PORT_SACT) = 1UL<<slot;
+	REG(s->port,PORT_CI) = 1UL<<slot;
+	goto repeat;
+}
+
+void do_sd_request(void)
+{
+	cli();
+	sd_start();
+	sti();
+}
+
+static void sd_port_stop(char * port)
+{
+	int i;
+
+	REG(port,PORT_CMD) &= ~CMD_ST;
+	for (i=0 ; i<100000 && (REG(port,PORT_CMD) & CMD_CR) ; i++)
+		/* nothing */ ;
+	REG(port,PORT_CMD) &= ~CMD_FRE;
+	for (i=0 ; i<100000 && (REG(port,PORT_CMD) & CMD_FR) ; i++)
+		/* nothing */ ;
+}
+
+static void sd_port_start(char * port)
+{
+	REG(port,PORT_SERR) = 0xffffffff;
+	REG(port,PORT_IS) = 0xffffffff;
+	REG(port,PORT_CMD) |= CMD_FRE;
+	REG(port,PORT_CMD) |= CMD_ST;
+}
+
+/*
+ * On an error the port stops processing commands, and we can't tell
+ * which of the queued ones failed: restart the port and fail them all.
+ */
+static void sd_error(struct sd_struct * s)
+{
+	int slot;
+
+	printk("ahci: error, status %02x\n\r",REG(s->port,PORT_TFD) & 0xff);
+	sd_port_stop(s->port);
+	sd_port_start(s->port);
+	for (slot=0 ; slot<32 ; slot++)
+		if (s->busy & (1UL<<slot))
+			end_io(request + s->slot[slot],0);
+	s->busy = s->nonq = 0;
+}
+
+static void sd_intr(void)
+{
+	struct sd_struct * s;
+	unsigned long is, done;
+	int slot;
+
+	for (s = sd_info ; s < sd_info+NR_SD_DISKS ; s++) {
+		if (!(is = REG(s->port,PORT_IS)))
+			continue;
+		REG(s->port,PORT_IS) = is;
+		if (is & IS_ERRORS) {
+			sd_error(s);
+			continue;
+		}
+		done = s->busy & ~REG(s->port,PORT_CI);
+		if (s->ncq)
+			done &= ~REG(s->port,PORT_SACT);
+		for (slot=0 ; done ; slot++)
+			if (done & (1UL<<slot)) {
+				done &= ~(1UL<<slot);
+				s->busy &= ~(1UL<<slot);
+				s->nonq &= ~(1UL<<slot);
+				end_io(request + s->slot[slot],1);
+			}
+	}
+	REG(abar,HBA_IS) = REG(abar,HBA_IS);
+	sd_start();
+}
+
+/*
+ * IDENTIFY DEVICE, polled: this runs at init time without interrupts.
+ */
+static int sd_identify_disk(struct sd_struct * s)
+{
+	struct ahci_cmd_table * tbl = s->mem->tbl;
+	int i;
+
+	sd_fis(tbl->cfis,ATA_IDENTIFY,0,0,0);
+	tbl->cfis[7] = 0;
+	tbl->prd[0].dba = (unsigned long) sd_identify;
+	tbl->prd[0].dbau = 0;
+	tbl->prd[0].dbc = 511;
+	s->mem->cmd_list[0].flags = 5 | (1<<16);
+	s->mem->cmd_list[0].prdbc = 0;
+	REG(s->port,PORT_CI) = 1;
+	for (i=0 ; i<10000000 && (REG(s->port,PORT_CI) & 1) ; i++)
+		/* nothing */ ;
+	if ((REG(s->port,PORT_CI) & 1) || (REG(s->port,PORT_TFD) & 1))
+		return 0;
+	REG(s->port,PORT_IS) = 0xffffffff;
+	return 1;
+}
+
+static int sd_probe_port(char * port, struct sd_struct * s,
+	struct ahci_port_mem * mem, unsigned long cap)
+{
+	int i, depth;
+	long sectors;
+
+	if ((REG(port,PORT_SSTS) & 0x0f) != 3 || REG(port,PORT_SIG) != SIG_ATA)
+		return 0;
+	sd_port_stop(port);
+	memset(mem,0,sizeof(*mem));
+	for (i=0 ; i<32 ; i++) {
+		mem->cmd_list[i].ctba = (unsigned long) (mem->tbl+i);
+		mem->cmd_list[i].ctbau = 0;
+	}
+	REG(port,PORT_CLB) = (unsigned long) mem->cmd_list;
+	REG(port,PORT_CLBU) = 0;
+	REG(port,PORT_FB) = (unsigned long) mem->fis;
+	REG(port,PORT_FBU) = 0;
+	REG(port,PORT_IE) = 0;
+	sd_port_start(port);
+	s->port = port;
+	s->mem = mem;
+	s->busy = s->nonq = 0;
+	if (!sd_identify_disk(s)) {
+		sd_port_stop(port);
+		return 0;
+	}
+	sectors = sd_identify[60] | (sd_identify[61] << 16);
+	if (sd_identify[83] & 0x400)
+		sectors = sd_identify[100] | (sd_identify[101] << 16);
+	depth = ((cap >> 8) & 0x1f) + 1;
+	if (depth > NR_REQUEST)
+		depth = NR_REQUEST;
+	s->ncq = 0;
+	if ((cap & CAP_SNCQ) && (sd_identify[76] & 0x100)) {
+		s->ncq = 1;
+		if (depth > (sd_identify[75] & 0x1f) + 1)
+			depth = (sd_identify[75] & 0x1f) + 1;
+	}
+	s->depth_mask = (depth == 32) ? 0xffffffff : (1UL<<depth)-1;
+	sd[5*NR_SD_DISKS].start_sect = 0;
+	sd[5*NR_SD_DISKS].nr_sects = sectors;
+	REG(port,PORT_IE) = IE_MASK;
+	printk("sd%c: %d sectors, %s, depth %d\n\r",'a'+NR_SD_DISKS,sectors,
+		s->ncq ? "NCQ" : "DMA",depth);
+	return 1;
+}
+
+/*
+ * Called from sys_setup(), like vd_setup().
+ */
+void sd_setup(void)
+{
+	struct buffer_head * bh;
+	struct partition * p;
+	int i, drive;
+
+	for (drive=0 ; drive<NR_SD_DISKS ; drive++) {
+		if (!(bh = bread(0xa00 + drive*5,0))) {
+			printk("Unable to read partition table of sd%c\n\r",
+				'a'+drive);
+			continue;
+		}
+		if (bh->b_data[510] == 0x55 &&
+		    (unsigned char) bh->b_data[511] == 0xAA) {
+			p = 0x1BE + (void *)bh->b_data;
+			for (i=1 ; i<5 ; i++,p++) {
+				sd[i+5*drive].start_sect = p->start_sect;
+				sd[i+5*drive].nr_sects = p->nr_sects;
+			}
+		}
+		brelse(bh);
+	}
+}
+
+void sd_init(void)
+{
+	struct pci_dev * pdev;
+	unsigned long cap, pi;
+	int port;
+
+	if (!(pdev = pci_find_class(0x010601,NULL)))
+		return;
+	pci_set_master(pdev);
+	abar = ahci_map(pci_read_config(pdev,PCI_BASE_ADDRESS_0+5*4) &
+		PCI_BASE_ADDRESS_MEM_MASK);
+	REG(abar,HBA_GHC) |= GHC_AE;
+	cap = REG(abar,HBA_CAP);
+	pi = REG(abar,HBA_PI);
+	for (port=0 ; port<30 && NR_SD_DISKS<NR_SD ; port++)
+		if ((pi & (1<<port)) &&
+		    sd_probe_port(abar+0x100+port*0x80,sd_info+NR_SD_DISKS,
+		    sd_mem+NR_SD_DISKS,cap))
+			NR_SD_DISKS++;
+	if (!NR_SD_DISKS)
+		return;
+	if (pci_request_irq(pdev->irq,sd_intr)) {
+		printk("ahci: can't use irq %d\n\r",pdev->irq);
+		NR_SD_DISKS = 0;
+		return;
+	}
+	REG(abar,HBA_IS) = 0xffffffff;
+	REG(abar,HBA_GHC) |= GHC_IE;
+	blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;
+	blk_dev[MAJOR_NR].max_sectors = SD_MAX_SECTORS;
+}
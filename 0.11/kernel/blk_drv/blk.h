@@ -1,7 +1,7 @@
 #ifndef _BLK_H
 #define _BLK_H
 
-#define NR_BLK_DEV	7
+#define NR_BLK_DEV	11
 /*
  * NR_REQUEST is the number of entries in the request-queue.
  * NOTE that writes may use only the low 2/3 of these: reads
@@ -42,15 +42,26 @@ struct request {
 ((s1)->dev < (s2)->dev || ((s1)->dev == (s2)->dev && \
 (s1)->sector < (s2)->sector))))
 
+/*
+ * If max_sectors is set, make_request() may add buffers for adjacent
+ * blocks to a request that is already queued: they are chained through
+ * b_reqnext from req->bh, and need not be contiguous in memory. Only
+ * drivers that take requests off the queue when they start them (so
+ * that everything on it is untouched) and that can scatter the data
+ * may set it.
+ */
 struct blk_dev_struct {
 	void (*request_fn)(void);
 	struct request * current_request;
+	int max_sectors;		/* 0 - no merging */
 };
 
 extern struct blk_dev_struct blk_dev[NR_BLK_DEV];
 extern struct request request[NR_REQUEST];
 extern struct task_struct * wait_for_request;
 
+extern void add_request(struct blk_dev_struct * dev, struct request * req);
+
 #ifdef MAJOR_NR
 
 /*
@@ -84,6 +95,30 @@ extern struct task_struct * wait_for_request;
 #define DEVICE_ON(device)
 #define DEVICE_OFF(device)
 
+#elif (MAJOR_NR == 8)
+/* loop device */
+#define DEVICE_NAME "loop"
+#define DEVICE_REQUEST do_loop_request
+#define DEVICE_NR(device) MINOR(device)
+#define DEVICE_ON(device)
+#define DEVICE_OFF(device)
+
+#elif (MAJOR_NR == 9)
+/* virtio disk */
+#define DEVICE_NAME "virtio-blk"
+#define DEVICE_REQUEST do_vd_request
+#define DEVICE_NR(device) (MINOR(device)/5)
+#define DEVICE_ON(device)
+#define DEVICE_OFF(device)
+
+#elif (MAJOR_NR == 10)
+/* AHCI SATA disk */
+#define DEVICE_NAME "ahci"
+#define DEVICE_REQUEST do_sd_request
+#define DEVICE_NR(device) (MINOR(device)/5)
+#define DEVICE_ON(device)
+#define DEVICE_OFF(device)
+
 #else
 /* unknown blk device */
 #error "unknown blk device"
@@ -115,8 +150,9 @@ static inline void end_request(int uptodate)
 	}
 	if (!uptodate) {
 		printk(DEVICE_NAME " I/O error\n\r");
-		printk("dev %04x, block %d\n\r",CURRENT->dev,
-			CURRENT->bh->b_blocknr);
+		if (CURRENT->bh)
+			printk("dev %04x, block %d\n\r",CURRENT->dev,
+				CURRENT->bh->b_blocknr);
 	}
 	wake_up(&CURRENT->waiting);
 	wake_up(&wait_for_request);
@@ -124,6 +160,39 @@ static inline void end_request(int uptodate)
 	CURRENT = CURRENT->next;
 }
 
+/*
+ * Drivers that keep several requests going at the same time take them
+ * off the queue with dequeue_request(), and complete them in whatever
+ * order the device finishes them with end_io().
+ */
+static inline struct request * dequeue_request(void)
+{
+	struct request * req;
+
+	if ((req = CURRENT))
+		CURRENT = req->next;
+	return req;
+}
+
+static inline void end_io(struct request * req, int uptodate)
+{
+	struct buffer_head * bh, * next;
+
+	for (bh = req->bh ; bh ; bh = next) {
+		next = bh->b_reqnext;
+		bh->b_reqnext = NULL;
+		bh->b_uptodate = uptodate;
+		unlock_buffer(bh);
+	}
+	if (!uptodate) {
+		printk(DEVICE_NAME " I/O error\n\r");
+		printk("dev %04x, sector %d\n\r",req->dev,req->sector);
+	}
+	wake_up(&req->waiting);
+	wake_up(&wait_for_request);
+	req->dev = -1;
+}
+
 #define INIT_REQUEST \
 repeat: \
 	if (!CURRENT) \
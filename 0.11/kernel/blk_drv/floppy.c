@@ -429,6 +429,10 @@ void do_fd_request(void)
 		return;
 	}
 	INIT_REQUEST;
+	if (CURRENT->cmd == FLUSH) {
+		end_request(1);
+		goto repeat;
+	}
 	floppy = (MINOR(CURRENT->dev)>>2) + floppy_type;
 	if (current_drive != CURRENT_DEV)
 		seek = 1;
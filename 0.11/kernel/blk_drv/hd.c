@@ -9,6 +9,11 @@
  * request-list, using interrupts to jump between functions. As
  * all the functions are called within interrupts, we may not
  * sleep. Special care is recommended.
+ *
+ * Where the controller doesn't interrupt (waiting for it to become
+ * ready, for DRQ after a write command, and during a reset) we don't
+ * spin on the status port either: the check is done once per timer
+ * tick, see hd_poll_start().
  * 
  *  modified by Drew Eckhardt to check nr of hd's from the CMOS.
  */
@@ -34,10 +39,21 @@ inb_p(0x71); \
 #define MAX_ERRORS	7
 #define MAX_HD		2
 
+/* How long (in ticks) we wait for the controller to do something */
+#define HD_READY_TIMEOUT	(HZ)
+#define HD_DRQ_TIMEOUT		(HZ)
+#define HD_RESET_TIMEOUT	(10*HZ)
+
 static void recal_intr(void);
 
 static int recalibrate = 0;
 static int reset = 0;
+static int reset_drive = 0;
+
+static void (*hd_poll)(void) = NULL;
+static long hd_poll_end = 0;
+static int hd_timer_armed = 0;
+static int hd_wcache[MAX_HD] = {0,};
 
 /*
  *  This struct defines the HD's and their types.
@@ -64,8 +80,50 @@ __asm__("cld;rep;insw"::"d" (port),"D" (buf),"c" (nr))
 #define port_write(port,buf,nr) \
 __asm__("cld;rep;outsw"::"d" (port),"S" (buf),"c" (nr))
 
+static int controller_ready(void);
+
 extern void hd_interrupt(void);
 extern void rd_load(void);
+extern void vd_setup(void);
+extern void sd_setup(void);
+
+/*
+ * Send a command that doesn't need an interrupt (with nIEN set, so we
+ * don't get one) and poll for the result. If 'buf' is given, the
+ * sector the drive returns is read into it.
+ */
+static int hd_poll_cmd(int drive, int feature, int cmd, void * buf)
+{
+	int i, r;
+
+	if (!controller_ready())
+		return 0;
+	outb_p(hd_info[drive].ctl | 2,HD_CMD);
+	outb_p(feature,HD_PRECOMP);
+	outb_p(0xA0|(drive<<4),HD_CURRENT);
+	outb(cmd,HD_COMMAND);
+	for (i=0 ; i<100000 && ((r=inb_p(HD_STATUS)) & BUSY_STAT) ; i++)
+		/* nothing */ ;
+	if (!(r & (BUSY_STAT|ERR_STAT)) && buf && (r & DRQ_STAT))
+		port_read(HD_DATA,buf,256);
+	outb_p(hd_info[drive].ctl,HD_CMD);
+	return !(r & (BUSY_STAT|ERR_STAT)) && (!buf || (r & DRQ_STAT));
+}
+
+/*
+ * Turn on the drive's write cache, if it has one. The data may then sit
+ * in the drive for a while, so we also have to flush it on sync.
+ */
+static int hd_set_wcache(int drive)
+{
+	unsigned short id[256];
+
+	if (!hd_poll_cmd(drive,0,WIN_IDENTIFY,id) || !(id[82] & 0x20))
+		return 0;
+	if (!hd_poll_cmd(drive,SETFEATURES_WCACHE,WIN_SETFEATURES,NULL))
+		return 0;
+	return 1;
+}
 
 /* This may be used only once, enforced by 'static int callable' */
 int sys_setup(void * BIOS)
@@ -153,11 +211,18 @@ int sys_setup(void * BIOS)
 	}
 	if (NR_HD)
 		printk("Partition table%s ok.\n\r",(NR_HD>1)?"s":"");
+	for (drive=0 ; drive<NR_HD ; drive++)
+		hd_wcache[drive] = hd_set_wcache(drive);
+	vd_setup();
+	sd_setup();
 	rd_load();
 	mount_root();
 	return (0);
 }
 
+/*
+ * Only used by hd_poll_cmd() at setup time: requests never spin.
+ */
 static int controller_ready(void)
 {
 	int retries=100000;
@@ -185,8 +250,7 @@ static void hd_out(unsigned int drive,unsigned int nsect,unsigned int sect,
 
 	if (drive>1 || head>15)
 		panic("Trying to write bad sector");
-	if (!controller_ready())
-		panic("HD controller not ready");
+	hd_poll = NULL;
 	do_hd = intr_addr;
 	outb_p(hd_info[drive].ctl,HD_CMD);
 	port=HD_DATA;
@@ -199,39 +263,70 @@ static void hd_out(unsigned int drive,unsigned int nsect,unsigned int sect,
 	outb(cmd,++port);
 }
 
-static int drive_busy(void)
+/*
+ * The timer can't be taken back once it is set, so there is only ever
+ * one, and what it calls is in hd_poll: issuing a new command clears
+ * that, so a poll for an old command never sees the new one.
+ */
+static void hd_timer(void)
 {
-	unsigned int i;
-
-	for (i = 0; i < 10000; i++)
-		if (READY_STAT == (inb_p(HD_STATUS) & (BUSY_STAT|READY_STAT)))
-			break;
-	i = inb(HD_STATUS);
-	i &= BUSY_STAT | READY_STAT | SEEK_STAT;
-	if (i == (READY_STAT | SEEK_STAT))
-		return(0);
-	printk("HD controller times out\n\r");
-	return(1);
+	hd_timer_armed = 0;
+	if (hd_poll)
+		hd_poll();
 }
 
-static void reset_controller(void)
+static void hd_poll_again(void)
 {
-	int	i;
+	if (!hd_timer_armed) {
+		hd_timer_armed = 1;
+		add_timer(1,&hd_timer);
+	}
+}
 
-	outb(4,HD_CMD);
-	for(i = 0; i < 100; i++) nop();
-	outb(hd_info[0].ctl & 0x0f ,HD_CMD);
-	if (drive_busy())
+/*
+ * Have 'fn' called on the next tick. It checks the controller status,
+ * and calls hd_poll_again() if it wants to look again and hd_poll_end
+ * hasn't passed yet.
+ */
+static void hd_poll_start(void (*fn)(void), long timeout)
+{
+	hd_poll = fn;
+	hd_poll_end = jiffies + timeout;
+	hd_poll_again();
+}
+
+static void reset_wait(void)
+{
+	int i;
+
+	i = inb(HD_STATUS) & (BUSY_STAT | READY_STAT | SEEK_STAT);
+	if (i != (READY_STAT | SEEK_STAT)) {
+		if (jiffies < hd_poll_end) {
+			hd_poll_again();
+			return;
+		}
+		printk("HD controller times out\n\r");
 		printk("HD-controller still busy\n\r");
-	if ((i = inb(HD_ERROR)) != 1)
+	} else if ((i = inb(HD_ERROR)) != 1)
 		printk("HD-controller reset failed: %02x\n\r",i);
+	hd_poll = NULL;
+	hd_out(reset_drive,hd_info[reset_drive].sect,hd_info[reset_drive].sect,
+		hd_info[reset_drive].head-1,hd_info[reset_drive].cyl,
+		WIN_SPECIFY,&recal_intr);
+}
+
+/* SRST has been held for a tick now, which is plenty */
+static void reset_release(void)
+{
+	outb(hd_info[0].ctl & 0x0f ,HD_CMD);
+	hd_poll_start(&reset_wait,HD_RESET_TIMEOUT);
 }
 
 static void reset_hd(int nr)
 {
-	reset_controller();
-	hd_out(nr,hd_info[nr].sect,hd_info[nr].sect,hd_info[nr].head-1,
-		hd_info[nr].cyl,WIN_SPECIFY,&recal_intr);
+	reset_drive = nr;
+	outb(4,HD_CMD);
+	hd_poll_start(&reset_release,1);
 }
 
 void unexpected_hd_interrupt(void)
@@ -284,6 +379,17 @@ static void write_intr(void)
 	do_hd_request();
 }
 
+static void flush_intr(void)
+{
+	if (win_result()) {
+		bad_rw_intr();
+		do_hd_request();
+		return;
+	}
+	end_request(1);
+	do_hd_request();
+}
+
 static void recal_intr(void)
 {
 	if (win_result())
@@ -291,9 +397,39 @@ static void recal_intr(void)
 	do_hd_request();
 }
 
+static void ready_poll(void)
+{
+	if (inb_p(HD_STATUS) & BUSY_STAT) {
+		if (jiffies < hd_poll_end) {
+			hd_poll_again();
+			return;
+		}
+		printk("HD controller not ready\n\r");
+		reset = 1;
+	}
+	hd_poll = NULL;
+	do_hd_request();
+}
+
+static void write_drq(void)
+{
+	if (!(inb_p(HD_STATUS) & DRQ_STAT)) {
+		if (jiffies < hd_poll_end) {
+			hd_poll_again();
+			return;
+		}
+		hd_poll = NULL;
+		do_hd = NULL;
+		bad_rw_intr();
+		do_hd_request();
+		return;
+	}
+	hd_poll = NULL;
+	port_write(HD_DATA,CURRENT->buffer,256);
+}
+
 void do_hd_request(void)
 {
-	int i,r = 0;
 	unsigned int block,dev;
 	unsigned int sec,head,cyl;
 	unsigned int nsect;
@@ -301,10 +437,15 @@ void do_hd_request(void)
 	INIT_REQUEST;
 	dev = MINOR(CURRENT->dev);
 	block = CURRENT->sector;
-	if (dev >= 5*NR_HD || (block+2) > (hd[dev].start_sect + hd[dev].nr_sects - 1)) {
+	if (dev >= 5*NR_HD || (CURRENT->cmd != FLUSH &&
+	    (block+2) > (hd[dev].start_sect + hd[dev].nr_sects - 1))) {
 		end_request(0);
 		goto repeat;
 	}
+	if (CURRENT->cmd == FLUSH && !hd_wcache[dev/5]) {
+		end_request(1);
+		goto repeat;
+	}
 	block += hd[dev].start_sect;
 	dev /= 5;
 	__asm__("divl %4":"=a" (block),"=d" (sec):"0" (block),"1" (0),
@@ -319,6 +460,10 @@ void do_hd_request(void)
 		reset_hd(CURRENT_DEV);
 		return;
 	}
+	if (inb_p(HD_STATUS) & BUSY_STAT) {
+		hd_poll_start(&ready_poll,HD_READY_TIMEOUT);
+		return;
+	}
 	if (recalibrate) {
 		recalibrate = 0;
 		hd_out(dev,hd_info[CURRENT_DEV].sect,0,0,0,
@@ -327,15 +472,11 @@ void do_hd_request(void)
 	}	
 	if (CURRENT->cmd == WRITE) {
 		hd_out(dev,nsect,sec,head,cyl,WIN_WRITE,&write_intr);
-		for(i=0 ; i<3000 && !(r=inb_p(HD_STATUS)&DRQ_STAT) ; i++)
-			/* nothing */ ;
-		if (!r) {
-			bad_rw_intr();
-			goto repeat;
-		}
-		port_write(HD_DATA,CURRENT->buffer,256);
+		hd_poll_start(&write_drq,HD_DRQ_TIMEOUT);
 	} else if (CURRENT->cmd == READ) {
 		hd_out(dev,nsect,sec,head,cyl,WIN_READ,&read_intr);
+	} else if (CURRENT->cmd == FLUSH) {
+		hd_out(dev,0,0,0,0,WIN_FLUSH,&flush_intr);
 	} else
 		panic("unknown hd-command");
 }
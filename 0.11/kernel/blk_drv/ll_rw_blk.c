@@ -36,7 +36,11 @@ struct blk_dev_struct blk_dev[NR_BLK_DEV] = {
 	{ NULL, NULL },		/* dev hd */
 	{ NULL, NULL },		/* dev ttyx */
 	{ NULL, NULL },		/* dev tty */
-	{ NULL, NULL }		/* dev lp */
+	{ NULL, NULL },		/* dev lp */
+	{ NULL, NULL },		/* dev pipes */
+	{ NULL, NULL },		/* dev loop */
+	{ NULL, NULL },		/* dev virtio-blk */
+	{ NULL, NULL }		/* dev ahci */
 };
 
 static inline void lock_buffer(struct buffer_head * bh)
@@ -59,9 +63,10 @@ static inline void unlock_buffer(struct buffer_head * bh)
 /*
  * add-request adds a request to the linked list.
  * It disables interrupts so that it can muck with the
- * request-lists in peace.
+ * request-lists in peace. The loop device uses it to pass
+ * its requests on to the real device.
  */
-static void add_request(struct blk_dev_struct * dev, struct request * req)
+void add_request(struct blk_dev_struct * dev, struct request * req)
 {
 	struct request * tmp;
 
@@ -85,6 +90,39 @@ static void add_request(struct blk_dev_struct * dev, struct request * req)
 	sti();
 }
 
+/*
+ * Try to add the buffer to a queued request for the blocks just before
+ * or after it. Called with interrupts off.
+ */
+static int merge_request(int major, int rw, struct buffer_head * bh)
+{
+	struct request * req;
+	unsigned long sector = bh->b_blocknr<<1;
+
+	for (req = blk_dev[major].current_request ; req ; req = req->next) {
+		if (req->dev != bh->b_dev || req->cmd != rw || !req->bh ||
+		    req->nr_sectors+2 > blk_dev[major].max_sectors)
+			continue;
+		if (req->sector+req->nr_sectors == sector) {
+			struct buffer_head * tmp = req->bh;
+
+			while (tmp->b_reqnext)
+				tmp = tmp->b_reqnext;
+			tmp->b_reqnext = bh;
+		} else if (sector+2 == req->sector) {
+			bh->b_reqnext = req->bh;
+			req->bh = bh;
+			req->buffer = bh->b_data;
+			req->sector = sector;
+		} else
+			continue;
+		req->nr_sectors += 2;
+		bh->b_dirt = 0;
+		return 1;
+	}
+	return 0;
+}
+
 static void make_request(int major,int rw, struct buffer_head * bh)
 {
 	struct request * req;
@@ -107,12 +145,23 @@ static void make_request(int major,int rw, struct buffer_head * bh)
 		unlock_buffer(bh);
 		return;
 	}
+	bh->b_reqnext = NULL;
+	if (blk_dev[major].max_sectors) {
+		cli();
+		if (merge_request(major,rw,bh)) {
+			sti();
+			return;
+		}
+		sti();
+	}
 repeat:
 /* we don't allow the write-requests to fill up the queue completely:
  * we want some room for reads: they take precedence. The last third
- * of the requests are only for reads.
+ * of the requests are only for reads. Loop device reads are kept out
+ * of it too: the loop driver may need to read indirect blocks of the
+ * backing file while its requests sit in the queue.
  */
-	if (rw == READ)
+	if (rw == READ && major != 8)
 		req = request+NR_REQUEST;
 	else
 		req = request+((NR_REQUEST*2)/3);
@@ -154,6 +203,101 @@ void ll_rw_block(int rw, struct buffer_head * bh)
 	make_request(major,rw,bh);
 }
 
+/*
+ * ll_rw_flush() asks the device to write out its volatile write cache,
+ * and waits until it has. There is no buffer: as for paging requests,
+ * bh is NULL and 'waiting' is what tells us it's done. Drivers without
+ * a write cache just end the request.
+ */
+void ll_rw_flush(int dev)
+{
+	struct request * req;
+	unsigned int major;
+
+	if ((major=MAJOR(dev)) >= NR_BLK_DEV || !(blk_dev[major].request_fn))
+		return;
+repeat:
+	req = request+NR_REQUEST;
+	while (--req >= request)
+		if (req->dev<0)
+			break;
+	if (req < request) {
+		sleep_on(&wait_for_request);
+		goto repeat;
+	}
+	req->dev = dev;
+	req->cmd = FLUSH;
+	req->errors = 0;
+	req->sector = 0;
+	req->nr_sectors = 0;
+	req->buffer = NULL;
+	req->waiting = current;
+	req->bh = NULL;
+	add_request(major+blk_dev,req);
+	cli();
+	while (req->waiting == current) {
+		current->state = TASK_UNINTERRUPTIBLE;
+		schedule();
+	}
+	sti();
+}
+
+/*
+ * wait_on_requests() sleeps until at least one of the 'nr' buffers has
+ * finished its I/O, and is what asynchronous I/O uses instead of
+ * wait_on_buffer(). We put ourselves in the 'waiting' slot of every
+ * request that is still queued for one of them, so that whichever
+ * end_request() comes first wakes us up. The slots are cleared again
+ * before we return: we must not be woken up there once we are sleeping
+ * on something else.
+ *
+ * Returns 0, or -EINTR if a signal woke us up first.
+ */
+int wait_on_requests(struct buffer_head ** bh, int nr)
+{
+	struct request * req;
+	struct buffer_head * tmp;
+	int i, queued;
+
+	cli();
+	for (i=0 ; i<nr ; i++)
+		if (bh[i] && !bh[i]->b_lock) {
+			sti();
+			return 0;
+		}
+	queued = 0;
+	for (req=request ; req<request+NR_REQUEST ; req++) {
+		if (req->dev < 0 || req->waiting)
+			continue;
+		for (tmp=req->bh ; tmp && !req->waiting ; tmp=tmp->b_reqnext)
+			for (i=0 ; i<nr ; i++)
+				if (tmp == bh[i]) {
+					req->waiting = current;
+					queued++;
+					break;
+				}
+	}
+/* locked, but not by a request we can see: fall back to sleeping on it */
+	if (!queued) {
+		for (i=0 ; i<nr ; i++)
+			if (bh[i] && bh[i]->b_lock) {
+				sleep_on(&bh[i]->b_wait);
+				break;
+			}
+		sti();
+		return 0;
+	}
+	current->state = TASK_INTERRUPTIBLE;
+	schedule();
+	for (req=request ; req<request+NR_REQUEST ; req++)
+		if (req->waiting == current)
+			req->waiting = NULL;
+	sti();
+	if (current->signal & ~current->blocked)
+		return -EINTR;
+	return 0;
+}
+
 void blk_dev_init(void)
 {
 	int i;
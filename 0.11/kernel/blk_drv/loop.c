@@ -0,0 +1,156 @@
+/*
+ *  linux/kernel/blk_drv/loop.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * loop.c lets a regular file be used as a block device. The loop device
+ * has no data of its own: every request is translated with bmap() into
+ * a request for the block of the device the file lives on, and then
+ * simply handed over to that device's queue. The data is thus read or
+ * written straight into the loop device's buffer by the real driver -
+ * no copy, and no second trip through the buffer cache.
+ *
+ * The translation may have to read indirect blocks (or allocate new
+ * blocks for writes), so it can sleep. That's ok: loop requests are
+ * only ever started from add_request(), ie in process context, and
+ * never from an interrupt.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/loop.h>
+#include <asm/system.h>
+
+#define MAJOR_NR 8
+#include "blk.h"
+
+static struct m_inode * loop_inode[NR_LOOP];
+
+/*
+ * The file may have buffers of its own in the cache (if it was read or
+ * written normally before being bound). Those are more recent than the
+ * disk for reads, and would be stale after our writes.
+ */
+static int loop_cached(int dev, int block)
+{
+	struct buffer_head * bh;
+
+	if (!(bh = get_hash_table(dev,block)))
+		return 0;
+	if (CURRENT->cmd == READ && bh->b_uptodate) {
+		memcpy(CURRENT->buffer,bh->b_data,BLOCK_SIZE);
+		brelse(bh);
+		return 1;
+	}
+	if (CURRENT->cmd == WRITE)
+		bh->b_uptodate = bh->b_dirt = 0;
+	brelse(bh);
+	return 0;
+}
+
+void do_loop_request(void)
+{
+	struct m_inode * inode;
+	struct request * req;
+	int block, nr;
+
+	INIT_REQUEST;
+	inode = NULL;
+	if (CURRENT_DEV < NR_LOOP)
+		inode = loop_inode[CURRENT_DEV];
+	if (inode && CURRENT->cmd == FLUSH) {
+		nr = 0;
+		goto forward;
+	}
+	block = CURRENT->sector >> 1;
+	if (!inode || block >= (inode->i_size+BLOCK_SIZE-1)/BLOCK_SIZE) {
+		end_request(0);
+		goto repeat;
+	}
+	if (CURRENT->cmd == WRITE)
+		nr = create_block(inode,block);
+	else
+		nr = bmap(inode,block);
+	if (!nr) {
+		if (CURRENT->cmd == READ)
+			memset(CURRENT->buffer,0,BLOCK_SIZE);
+		end_request(CURRENT->cmd == READ);
+		goto repeat;
+	}
+	if (loop_cached(inode->i_dev,nr)) {
+		end_request(1);
+		goto repeat;
+	}
+forward:
+	cli();
+	req = dequeue_request();
+	sti();
+	req->dev = inode->i_dev;
+	req->sector = nr << 1;
+	add_request(MAJOR(inode->i_dev)+blk_dev,req);
+	goto repeat;
+}
+
+static int loop_set_fd(int dev, unsigned int fd)
+{
+	struct m_inode * inode;
+	struct file * file;
+
+	if (fd >= NR_OPEN || !(file = current->filp[fd]))
+		return -EBADF;
+	inode = file->f_inode;
+	if (!S_ISREG(inode->i_mode))
+		return -EINVAL;
+	if (MAJOR(inode->i_dev) == MAJOR_NR || MAJOR(inode->i_dev) >= NR_BLK_DEV
+	    || !blk_dev[MAJOR(inode->i_dev)].request_fn)
+		return -EINVAL;
+	if (loop_inode[DEVICE_NR(dev)])
+		return -EBUSY;
+	inode->i_count++;
+	loop_inode[DEVICE_NR(dev)] = inode;
+	invalidate_buffers(dev);
+	return 0;
+}
+
+static int loop_clr_fd(int dev)
+{
+	struct m_inode * inode;
+
+	if (!(inode = loop_inode[DEVICE_NR(dev)]))
+		return -ENXIO;
+	if (get_super(dev))
+		return -EBUSY;
+	sync_dev(dev);
+	invalidate_buffers(dev);
+	loop_inode[DEVICE_NR(dev)] = NULL;
+	iput(inode);
+	return 0;
+}
+
+int loop_ioctl(int dev, int cmd, int arg)
+{
+	if (DEVICE_NR(dev) >= NR_LOOP)
+		return -ENODEV;
+	if (!suser())
+		return -EPERM;
+	switch (cmd) {
+		case LOOP_SET_FD:
+			return loop_set_fd(dev,arg);
+		case LOOP_CLR_FD:
+			return loop_clr_fd(dev);
+		default:
+			return -EINVAL;
+	}
+}
+
+void loop_init(void)
+{
+	blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;
+}
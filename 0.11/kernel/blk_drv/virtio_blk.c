@@ -0,0 +1,329 @@
+/*
+ *  linux/kernel/blk_drv/virtio_blk.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * virtio_blk.c is a driver for the (legacy) virtio block device that
+ * QEMU and friends provide. Unlike the hd driver it doesn't work on one
+ * request at a time: every request is taken off the queue as soon as it
+ * is handed to the device, so that the device has as many as we can fit
+ * into its ring, and completions come back in any order.
+ *
+ * A request is a chain of descriptors: the request header, one buffer
+ * for each block (requests are merged, see ll_rw_blk.c), and the status
+ * byte the device writes back.
+ *
+ * Minors are as for the hd driver: 0 is the whole first disk, 1-4 its
+ * partitions, 5 the second disk etc.
+ */
+
+#include <string.h>
+
+#include <linux/config.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/hdreg.h>
+#include <linux/pci.h>
+#include <asm/system.h>
+#include <asm/io.h>
+
+#define MAJOR_NR 9
+#include "blk.h"
+
+#define NR_VD		2
+#define VD_QUEUE_MAX	256
+#define VD_RING_SIZE	(3*4096)	/* enough for VD_QUEUE_MAX entries */
+#define VD_MAX_SECTORS	64		/* per request after merging */
+
+/* legacy virtio PCI registers, relative to BAR 0 */
+#define VIRTIO_PCI_HOST_FEATURES	0x00
+#define VIRTIO_PCI_GUEST_FEATURES	0x04
+#define VIRTIO_PCI_QUEUE_PFN		0x08
+#define VIRTIO_PCI_QUEUE_NUM		0x0c
+#define VIRTIO_PCI_QUEUE_SEL		0x0e
+#define VIRTIO_PCI_QUEUE_NOTIFY		0x10
+#define VIRTIO_PCI_STATUS		0x12
+#define VIRTIO_PCI_ISR			0x13
+#define VIRTIO_PCI_CONFIG		0x14	/* capacity, in sectors */
+
+#define VIRTIO_STATUS_ACKNOWLEDGE	1
+#define VIRTIO_STATUS_DRIVER		2
+#define VIRTIO_STATUS_DRIVER_OK		4
+#define VIRTIO_STATUS_FAILED		128
+
+#define VRING_DESC_F_NEXT	1
+#define VRING_DESC_F_WRITE	2
+
+#define VIRTIO_BLK_T_IN		0
+#define VIRTIO_BLK_T_OUT	1
+#define VIRTIO_BLK_T_FLUSH	4
+
+#define VIRTIO_BLK_F_FLUSH	0x200	/* device has a write cache */
+
+#define barrier() __asm__ __volatile__("":::"memory")
+
+struct vring_desc {
+	unsigned long addr;
+	unsigned long addr_hi;
+	unsigned long len;
+	unsigned short flags;
+	unsigned short next;
+};
+
+struct vring_avail {
+	unsigned short flags;
+	unsigned short idx;
+	unsigned short ring[VD_QUEUE_MAX];
+};
+
+struct vring_used {
+	unsigned short flags;
+	unsigned short idx;
+	struct {
+		unsigned long id;
+		unsigned long len;
+	} ring[VD_QUEUE_MAX];
+};
+
+/* what the device needs besides the data, one for each request slot */
+struct vd_cmd {
+	unsigned long type;
+	unsigned long ioprio;
+	unsigned long sector;
+	unsigned long sector_hi;
+	unsigned char status;
+};
+
+static struct vd_struct {
+	int iobase;
+	int qsize;
+	int flush;			/* write cache needs flushing */
+	struct vring_desc * desc;
+	struct vring_avail * avail;
+	volatile struct vring_used * used;
+	unsigned short last_used;
+	unsigned short free_head;
+	int nr_free;
+	unsigned char slot[VD_QUEUE_MAX];	/* head descriptor -> request */
+	struct vd_cmd cmd[NR_REQUEST];
+} vd_info[NR_VD];
+
+static int NR_VD_DISKS = 0;
+
+static struct vd_part {
+	long start_sect;
+	long nr_sects;
+} vd[5*NR_VD];
+
+static char vd_ring[NR_VD][VD_RING_SIZE] __attribute__ ((aligned (4096)));
+
+/*
+ * Take the next free descriptor. The free ones are chained through
+ * 'next', so the descriptors of one request come out already linked.
+ */
+static int vd_desc(struct vd_struct * v, void * addr, int len, int flags)
+{
+	int i = v->free_head;
+
+	v->free_head = v->desc[i].next;
+	v->nr_free--;
+	v->desc[i].addr = (unsigned long) addr;
+	v->desc[i].addr_hi = 0;
+	v->desc[i].len = len;
+	v->desc[i].flags = flags | VRING_DESC_F_NEXT;
+	return i;
+}
+
+/*
+ * Start as many requests as fit into the rings. Interrupts must be off:
+ * this is called both from do_vd_request() and the interrupt handler.
+ */
+static void vd_start(void)
+{
+	struct vd_struct * v;
+	struct vd_cmd * cmd;
+	struct request * req;
+	struct buffer_head * bh;
+	int dev, n, head, last, flags;
+
+	INIT_REQUEST;
+	dev = MINOR(CURRENT->dev);
+	v = vd_info + CURRENT_DEV;
+	if (dev >= 5*NR_VD_DISKS ||
+	    CURRENT->sector+CURRENT->nr_sectors > vd[dev].nr_sects) {
+		end_io(dequeue_request(),0);
+		goto repeat;
+	}
+	if (CURRENT->cmd == FLUSH && !v->flush) {
+		end_io(dequeue_request(),1);
+		goto repeat;
+	}
+	n = 2;
+	if (!CURRENT->bh && CURRENT->nr_sectors)
+		n++;
+	for (bh = CURRENT->bh ; bh ; bh = bh->b_reqnext)
+		n++;
+	if (v->nr_free < n)
+		return;			/* wait for a completion */
+	req = dequeue_request();
+	cmd = v->cmd + (req - request);
+	if (req->cmd == FLUSH)
+		cmd->type = VIRTIO_BLK_T_FLUSH;
+	else if (req->cmd == WRITE)
+		cmd->type = VIRTIO_BLK_T_OUT;
+	else
+		cmd->type = VIRTIO_BLK_T_IN;
+	cmd->ioprio = 0;
+	if (req->cmd == FLUSH)
+		cmd->sector = 0;
+	else
+		cmd->sector = req->sector + vd[dev].start_sect;
+	cmd->sector_hi = 0;
+	cmd->status = 0xff;
+	flags = (req->cmd == WRITE) ? 0 : VRING_DESC_F_WRITE;
+	head = vd_desc(v,cmd,16,0);
+	if (!req->bh && req->nr_sectors)
+		vd_desc(v,req->buffer,req->nr_sectors<<9,flags);
+	for (bh = req->bh ; bh ; bh = bh->b_reqnext)
+		vd_desc(v,bh->b_data,BLOCK_SIZE,flags);
+	last = vd_desc(v,&cmd->status,1,VRING_DESC_F_WRITE);
+	v->desc[last].flags = VRING_DESC_F_WRITE;
+	v->slot[head] = req - request;
+	v->avail->ring[v->avail->idx % v->qsize] = head;
+	barrier();
+	v->avail->idx++;
+	barrier();
+	outw(0,v->iobase+VIRTIO_PCI_QUEUE_NOTIFY);
+	goto repeat;
+}
+
+void do_vd_request(void)
+{
+	cli();
+	vd_start();
+	sti();
+}
+
+static void vd_intr(void)
+{
+	struct vd_struct * v;
+	struct vd_cmd * cmd;
+	int head, i, n;
+
+	for (v = vd_info ; v < vd_info+NR_VD_DISKS ; v++) {
+		if (!(inb(v->iobase+VIRTIO_PCI_ISR) & 1))
+			continue;
+		while (v->last_used != v->used->idx) {
+			barrier();
+			head = v->used->ring[v->last_used % v->qsize].id;
+			v->last_used++;
+			for (i = head, n = 1 ; v->desc[i].flags & VRING_DESC_F_NEXT ; n++)
+				i = v->desc[i].next;
+			v->desc[i].next = v->free_head;
+			v->free_head = head;
+			v->nr_free += n;
+			cmd = v->cmd + v->slot[head];
+			end_io(request + v->slot[head], cmd->status == 0);
+		}
+	}
+	vd_start();
+}
+
+static int vd_probe(struct pci_dev * pdev, struct vd_struct * v, char * ring)
+{
+	unsigned long bar;
+	int i, qsize;
+
+	bar = pci_read_config(pdev,PCI_BASE_ADDRESS_0);
+	if (!(bar & PCI_BASE_ADDRESS_SPACE_IO))
+		return 0;
+	pci_set_master(pdev);
+	v->iobase = bar & PCI_BASE_ADDRESS_IO_MASK;
+	outb(0,v->iobase+VIRTIO_PCI_STATUS);
+	outb(VIRTIO_STATUS_ACKNOWLEDGE,v->iobase+VIRTIO_PCI_STATUS);
+	outb(VIRTIO_STATUS_ACKNOWLEDGE|VIRTIO_STATUS_DRIVER,
+		v->iobase+VIRTIO_PCI_STATUS);
+	v->flush = inl(v->iobase+VIRTIO_PCI_HOST_FEATURES) & VIRTIO_BLK_F_FLUSH;
+	outl(v->flush,v->iobase+VIRTIO_PCI_GUEST_FEATURES);
+	outw(0,v->iobase+VIRTIO_PCI_QUEUE_SEL);
+	qsize = inw(v->iobase+VIRTIO_PCI_QUEUE_NUM);
+	if (qsize < VD_MAX_SECTORS/2+2 || qsize > VD_QUEUE_MAX) {
+		printk("virtio-blk: unusable queue size %d\n\r",qsize);
+		outb(VIRTIO_STATUS_FAILED,v->iobase+VIRTIO_PCI_STATUS);
+		return 0;
+	}
+	memset(ring,0,VD_RING_SIZE);
+	v->qsize = qsize;
+	v->desc = (struct vring_desc *) ring;
+	v->avail = (struct vring_avail *) (ring + 16*qsize);
+	v->used = (struct vring_used *)
+		(ring + ((16*qsize + 6 + 2*qsize + 4095) & ~4095));
+	for (i=0 ; i<qsize ; i++)
+		v->desc[i].next = i+1;
+	v->free_head = 0;
+	v->nr_free = qsize;
+	v->last_used = 0;
+	outl((unsigned long) ring >> 12,v->iobase+VIRTIO_PCI_QUEUE_PFN);
+	if (pci_request_irq(pdev->irq,vd_intr)) {
+		printk("virtio-blk: can't use irq %d\n\r",pdev->irq);
+		outb(VIRTIO_STATUS_FAILED,v->iobase+VIRTIO_PCI_STATUS);
+		return 0;
+	}
+	outb(VIRTIO_STATUS_ACKNOWLEDGE|VIRTIO_STATUS_DRIVER|
+		VIRTIO_STATUS_DRIVER_OK,v->iobase+VIRTIO_PCI_STATUS);
+	return 1;
+}
+
+/*
+ * Called from sys_setup(): reading the partition tables needs
+ * interrupts, so it can't be done in vd_init().
+ */
+void vd_setup(void)
+{
+	struct buffer_head * bh;
+	struct partition * p;
+	int i, drive;
+
+	for (drive=0 ; drive<NR_VD_DISKS ; drive++) {
+		if (!(bh = bread(0x900 + drive*5,0))) {
+			printk("Unable to read partition table of vd%c\n\r",
+				'a'+drive);
+			continue;
+		}
+		if (bh->b_data[510] == 0x55 &&
+		    (unsigned char) bh->b_data[511] == 0xAA) {
+			p = 0x1BE + (void *)bh->b_data;
+			for (i=1 ; i<5 ; i++,p++) {
+				vd[i+5*drive].start_sect = p->start_sect;
+				vd[i+5*drive].nr_sects = p->nr_sects;
+			}
+		}
+		brelse(bh);
+	}
+}
+
+void vd_init(void)
+{
+	struct pci_dev * pdev = NULL;
+	struct vd_struct * v;
+
+	while (NR_VD_DISKS < NR_VD &&
+	       (pdev = pci_find_device(0x1af4,0x1001,pdev))) {
+		v = vd_info + NR_VD_DISKS;
+		if (!vd_probe(pdev,v,vd_ring[NR_VD_DISKS]))
+			continue;
+		vd[5*NR_VD_DISKS].start_sect = 0;
+		vd[5*NR_VD_DISKS].nr_sects =
+			inl(v->iobase+VIRTIO_PCI_CONFIG);
+		printk("vd%c: %d sectors\n\r",'a'+NR_VD_DISKS,
+			vd[5*NR_VD_DISKS].nr_sects);
+		NR_VD_DISKS++;
+	}
+	if (!NR_VD_DISKS)
+		return;
+	blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;
+	blk_dev[MAJOR_NR].max_sectors = VD_MAX_SECTORS;
+}
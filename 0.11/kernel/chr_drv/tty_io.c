@@ -231,7 +231,8 @@ int tty_read(unsigned channel, char * buf, int nr)
 {
 	struct tty_struct * tty;
 	char c, * b=buf;
-	int minimum,time,flag=0;
+	char tmp[64];
+	int minimum,time,flag=0,n;
 	long oldalarm;
 
 	if (channel>2 || nr<0) return -1;
@@ -258,18 +259,27 @@ int tty_read(unsigned channel, char * buf, int nr)
 			sleep_if_empty(&tty->secondary);
 			continue;
 		}
+		n = 0;
 		do {
 			GETCH(tty->secondary,c);
 			if (c==EOF_CHAR(tty) || c==10)
 				tty->secondary.data--;
-			if (c==EOF_CHAR(tty) && L_CANON(tty))
-				return (b-buf);
-			else {
-				put_fs_byte(c,b++);
+			if (c==EOF_CHAR(tty) && L_CANON(tty)) {
+				memcpy_tofs(b,tmp,n);
+				return (b+n-buf);
+			} else {
+				tmp[n++] = c;
+				if (n == sizeof(tmp)) {
+					memcpy_tofs(b,tmp,n);
+					b += n;
+					n = 0;
+				}
 				if (!--nr)
 					break;
 			}
 		} while (nr>0 && !EMPTY(tty->secondary));
+		memcpy_tofs(b,tmp,n);
+		b += n;
 		if (time && !L_CANON(tty)) {
 			if ((flag=(!oldalarm || time+jiffies<oldalarm)))
 				current->alarm = time+jiffies;
@@ -293,6 +303,8 @@ int tty_write(unsigned channel, char * buf, int nr)
 	static int cr_flag=0;
 	struct tty_struct * tty;
 	char c, *b=buf;
+	char tmp[64];
+	int i=0, n=0;		/* tmp[i..n-1] is a copy of b[0..] */
 
 	if (channel>2 || nr<0) return -1;
 	tty = channel + tty_table;
@@ -301,7 +313,12 @@ int tty_write(unsigned channel, char * buf, int nr)
 		if (current->signal)
 			break;
 		while (nr>0 && !FULL(tty->write_q)) {
-			c=get_fs_byte(b);
+			if (i >= n) {
+				n = (nr < sizeof(tmp)) ? nr : sizeof(tmp);
+				memcpy_fromfs(tmp,b,n);
+				i = 0;
+			}
+			c=tmp[i];
 			if (O_POST(tty)) {
 				if (c=='\r' && O_CRNL(tty))
 					c='\n';
@@ -315,7 +332,7 @@ int tty_write(unsigned channel, char * buf, int nr)
 				if (O_LCUC(tty))
 					c=toupper(c);
 			}
-			b++; nr--;
+			b++; nr--; i++;
 			cr_flag = 0;
 			PUTCH(c,tty->write_q);
 		}
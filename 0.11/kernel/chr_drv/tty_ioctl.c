@@ -55,20 +55,14 @@ static void send_break(struct tty_struct * tty)
 
 static int get_termios(struct tty_struct * tty, struct termios * termios)
 {
-	int i;
-
 	verify_area(termios, sizeof (*termios));
-	for (i=0 ; i< (sizeof (*termios)) ; i++)
-		put_fs_byte( ((char *)&tty->termios)[i] , i+(char *)termios );
+	memcpy_tofs(termios,&tty->termios,sizeof (*termios));
 	return 0;
 }
 
 static int set_termios(struct tty_struct * tty, struct termios * termios)
 {
-	int i;
-
-	for (i=0 ; i< (sizeof (*termios)) ; i++)
-		((char *)&tty->termios)[i]=get_fs_byte(i+(char *)termios);
+	memcpy_fromfs(&tty->termios,termios,sizeof (*termios));
 	change_speed(tty);
 	return 0;
 }
@@ -86,8 +80,7 @@ static int get_termio(struct tty_struct * tty, struct termio * termio)
 	tmp_termio.c_line = tty->termios.c_line;
 	for(i=0 ; i < NCC ; i++)
 		tmp_termio.c_cc[i] = tty->termios.c_cc[i];
-	for (i=0 ; i< (sizeof (*termio)) ; i++)
-		put_fs_byte( ((char *)&tmp_termio)[i] , i+(char *)termio );
+	memcpy_tofs(termio,&tmp_termio,sizeof (*termio));
 	return 0;
 }
 
@@ -99,8 +92,7 @@ static int set_termio(struct tty_struct * tty, struct termio * termio)
 	int i;
 	struct termio tmp_termio;
 
-	for (i=0 ; i< (sizeof (*termio)) ; i++)
-		((char *)&tmp_termio)[i]=get_fs_byte(i+(char *)termio);
+	memcpy_fromfs(&tmp_termio,termio,sizeof (*termio));
 	*(unsigned short *)&tty->termios.c_iflag = tmp_termio.c_iflag;
 	*(unsigned short *)&tty->termios.c_oflag = tmp_termio.c_oflag;
 	*(unsigned short *)&tty->termios.c_cflag = tmp_termio.c_cflag;
@@ -102,6 +102,8 @@ static void tell_father(int pid)
 int do_exit(long code)
 {
 	int i;
+	exit_aio();
+	exit_mmap();
 	free_page_tables(get_base(current->ldt[1]),get_limit(0x0f));
 	free_page_tables(get_base(current->ldt[2]),get_limit(0x17));
 	for (i=0 ; i<NR_TASKS ; i++)
@@ -0,0 +1,202 @@
+/*
+ *  linux/kernel/pci.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * A minimal PCI bus scanner, using configuration mechanism #1 (ports
+ * 0xCF8/0xCFC). The devices found at boot are kept in pci_devices[],
+ * where the drivers can look them up.
+ *
+ * PCI interrupt lines can be shared, and the drivers don't know in
+ * advance which one they get, so they all go through pci_interrupt:
+ * we ask the interrupt controllers which irq is being serviced and call
+ * every handler registered for it. The handlers have to acknowledge
+ * the interrupt at the device before we send the EOI.
+ */
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <linux/pci.h>
+#include <asm/system.h>
+#include <asm/io.h>
+
+#define PCI_CONFIG_ADDRESS	0xCF8
+#define PCI_CONFIG_DATA		0xCFC
+
+#define NR_PCI_HANDLERS	8
+
+extern void pci_interrupt(void);
+
+struct pci_dev pci_devices[NR_PCI];
+int nr_pci_devices = 0;
+
+static struct {
+	int irq;
+	void (*handler)(void);
+} pci_handlers[NR_PCI_HANDLERS];
+
+static unsigned long pci_conf_read(int bus, int devfn, int where)
+{
+	outl(0x80000000 | (bus<<16) | (devfn<<8) | (where & 0xfc),
+		PCI_CONFIG_ADDRESS);
+	return inl(PCI_CONFIG_DATA);
+}
+
+static void pci_conf_write(int bus, int devfn, int where,
+	unsigned long value)
+{
+	outl(0x80000000 | (bus<<16) | (devfn<<8) | (where & 0xfc),
+		PCI_CONFIG_ADDRESS);
+	outl(value,PCI_CONFIG_DATA);
+}
+
+unsigned long pci_read_config(struct pci_dev * dev, int where)
+{
+	return pci_conf_read(dev->bus,dev->devfn,where);
+}
+
+void pci_write_config(struct pci_dev * dev, int where, unsigned long value)
+{
+	pci_conf_write(dev->bus,dev->devfn,where,value);
+}
+
+/*
+ * Enable decoding of the device's I/O and memory ranges, and let it
+ * do DMA.
+ */
+void pci_set_master(struct pci_dev * dev)
+{
+	unsigned long cmd;
+
+	cmd = pci_read_config(dev,PCI_COMMAND);
+	cmd |= PCI_COMMAND_IO | PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER;
+	pci_write_config(dev,PCI_COMMAND,cmd & 0xffff);
+}
+
+struct pci_dev * pci_find_device(unsigned short vendor,
+	unsigned short device, struct pci_dev * from)
+{
+	struct pci_dev * dev;
+
+	dev = from ? from+1 : pci_devices;
+	for ( ; dev < pci_devices+nr_pci_devices ; dev++)
+		if (dev->vendor == vendor && dev->device == device)
+			return dev;
+	return NULL;
+}
+
+struct pci_dev * pci_find_class(unsigned long class, struct pci_dev * from)
+{
+	struct pci_dev * dev;
+
+	dev = from ? from+1 : pci_devices;
+	for ( ; dev < pci_devices+nr_pci_devices ; dev++)
+		if (dev->class == class)
+			return dev;
+	return NULL;
+}
+
+/*
+ * Called from pci_interrupt, with interrupts disabled.
+ */
+void do_pci_interrupt(void)
+{
+	unsigned char isr;
+	int i, irq;
+
+	outb(0x0B,0x20);		/* next read gives the ISR */
+	isr = inb(0x20);
+	if (isr & 0x04) {
+		outb(0x0B,0xA0);
+		isr = inb(0xA0);
+		irq = 8;
+	} else
+		irq = 0;
+	if (!isr)
+		return;			/* spurious */
+	while (!(isr & 1)) {
+		isr >>= 1;
+		irq++;
+	}
+	for (i=0 ; i<NR_PCI_HANDLERS ; i++)
+		if (pci_handlers[i].handler && pci_handlers[i].irq == irq)
+			pci_handlers[i].handler();
+	if (irq >= 8)
+		outb(0x20,0xA0);
+	outb(0x20,0x20);
+}
+
+/*
+ * Drivers register their handlers at init time, with interrupts still
+ * disabled.
+ */
+int pci_request_irq(int irq, void (*handler)(void))
+{
+	int i;
+
+	if (irq < 3 || irq > 15 || irq == 8)
+		return -1;
+	for (i=0 ; i<NR_PCI_HANDLERS ; i++)
+		if (!pci_handlers[i].handler)
+			break;
+	if (i >= NR_PCI_HANDLERS)
+		return -1;
+	pci_handlers[i].irq = irq;
+	pci_handlers[i].handler = handler;
+	set_intr_gate(0x20+irq,&pci_interrupt);
+	if (irq < 8)
+		outb_p(inb_p(0x21)&~(1<<irq),0x21);
+	else {
+		outb_p(inb_p(0x21)&0xfb,0x21);
+		outb(inb_p(0xA1)&~(1<<(irq-8)),0xA1);
+	}
+	return 0;
+}
+
+static void pci_scan_device(int bus, int devfn)
+{
+	struct pci_dev * dev;
+	unsigned long id;
+
+	id = pci_conf_read(bus,devfn,PCI_VENDOR_ID);
+	if ((id & 0xffff) == 0xffff || !(id & 0xffff))
+		return;
+	if (nr_pci_devices >= NR_PCI) {
+		printk("pci: too many devices\n\r");
+		return;
+	}
+	dev = pci_devices + nr_pci_devices++;
+	dev->bus = bus;
+	dev->devfn = devfn;
+	dev->vendor = id & 0xffff;
+	dev->device = id >> 16;
+	dev->class = pci_conf_read(bus,devfn,PCI_CLASS_REVISION) >> 8;
+	dev->irq = pci_conf_read(bus,devfn,PCI_INTERRUPT_LINE) & 0xff;
+}
+
+/*
+ * Called from main() with interrupts still disabled, before the disk
+ * drivers are initialized.
+ */
+void pci_init(void)
+{
+	int bus, slot, fn, nfn;
+
+	outl(0x80000000,PCI_CONFIG_ADDRESS);
+	if (inl(PCI_CONFIG_ADDRESS) != 0x80000000)
+		return;			/* no PCI */
+	for (bus=0 ; bus<256 ; bus++)
+		for (slot=0 ; slot<32 ; slot++) {
+			if ((pci_conf_read(bus,slot<<3,PCI_VENDOR_ID) & 0xffff)
+			    == 0xffff)
+				continue;
+			nfn = (pci_conf_read(bus,slot<<3,PCI_HEADER_TYPE)
+				& 0x800000) ? 8 : 1;
+			for (fn=0 ; fn<nfn ; fn++)
+				pci_scan_device(bus,(slot<<3)+fn);
+		}
+	if (nr_pci_devices)
+		printk("pci: %d devices\n\r",nr_pci_devices);
+}
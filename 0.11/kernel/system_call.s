@@ -70,14 +70,14 @@ sa_flags = 8
 sa_restorer = 12
 
 #系统调用总数
-nr_system_calls = 72   
+nr_system_calls = 83   
 
 /*
  * Ok, I get parallel printer interrupts while using the floppy for some
  * strange reason. Urgel. Now I just ignore them.
  */
 .globl system_call,sys_fork,timer_interrupt,sys_execve
-.globl hd_interrupt,floppy_interrupt,parallel_interrupt
+.globl hd_interrupt,floppy_interrupt,parallel_interrupt,pci_interrupt
 .globl device_not_available, coprocessor_error
 
 .align 2
@@ -337,3 +337,26 @@ parallel_interrupt:
 	outb %al,$0x20
 	popl %eax
 	iret
+
+# PCI interrupts may be shared: do_pci_interrupt finds out which irq
+# it is, calls the drivers and sends the EOI itself.
+pci_interrupt:
+	pushl %eax
+	pushl %ecx
+	pushl %edx
+	push %ds
+	push %es
+	push %fs
+	movl $0x10,%eax
+	mov %ax,%ds
+	mov %ax,%es
+	movl $0x17,%eax
+	mov %ax,%fs
+	call do_pci_interrupt
+	pop %fs
+	pop %es
+	pop %ds
+	popl %edx
+	popl %ecx
+	popl %eax
+	iret
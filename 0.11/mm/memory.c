@@ -21,6 +21,7 @@
  */
 
 #include <signal.h>
+#include <sys/mman.h>
 
 #include <asm/system.h>
 
@@ -237,6 +238,27 @@ void un_wp_page(unsigned long * table_entry)
 	copy_page(old_page,new_page);
 }	
 
+/*
+ * A write to a write-protected page. Pages of shared mappings are
+ * shared on purpose (after fork()), so they are just made writable;
+ * read-only mappings may not be written at all.
+ */
+static void wp_page(unsigned long * table_entry, unsigned long address)
+{
+	struct vm_area * vma;
+
+	if ((vma = find_vma(address - current->start_code))) {
+		if (!(vma->vm_prot & PROT_WRITE))
+			do_exit(SIGSEGV);
+		if (vma->vm_flags & MAP_SHARED) {
+			*table_entry |= 2;
+			invalidate();
+			return;
+		}
+	}
+	un_wp_page(table_entry);
+}
+
 /*
  * This routine handles present pages, when users try to write
  * to a shared page. It is done by copying the page to a new address
@@ -252,9 +274,9 @@ void do_wp_page(unsigned long error_code,unsigned long address)
 	if (CODE_SPACE(address))
 		do_exit(SIGSEGV);
 #endif
-	un_wp_page((unsigned long *)
+	wp_page((unsigned long *)
 		(((address>>10) & 0xffc) + (0xfffff000 &
-		*((unsigned long *) ((address>>20) &0xffc)))));
+		*((unsigned long *) ((address>>20) &0xffc)))),address);
 
 }
 
@@ -267,7 +289,7 @@ void write_verify(unsigned long address)
 	page &= 0xfffff000;
 	page += ((address>>10) & 0xffc);
 	if ((3 & *(unsigned long *) page) == 1)  /* non-writeable, present */
-		un_wp_page((unsigned long *) page);
+		wp_page((unsigned long *) page,address);
 	return;
 }
 
@@ -363,15 +385,43 @@ static int share_page(unsigned long address)
 	return 0;
 }
 
+/*
+ * A page of an mmap() area: zero-filled, or read from the file.
+ */
+static void vma_no_page(struct vm_area * vma, unsigned long address)
+{
+	unsigned long page;
+
+	if (!(vma->vm_prot & (PROT_READ|PROT_WRITE|PROT_EXEC)))
+		do_exit(SIGSEGV);
+	if (!(page = get_free_page()))
+		oom();
+	if (vma->vm_inode)
+		read_vma_page(vma,address - current->start_code,page);
+	if (!put_page(page,address)) {
+		free_page(page);
+		oom();
+	}
+	if (!(vma->vm_prot & PROT_WRITE))
+		((unsigned long *) (0xfffff000 &
+		*((unsigned long *) ((address>>20) & 0xffc))))
+			[(address>>12) & 0x3ff] &= ~2;
+}
+
 void do_no_page(unsigned long error_code,unsigned long address)
 {
 	int nr[4];
 	unsigned long tmp;
 	unsigned long page;
+	struct vm_area * vma;
 	int block,i;
 
 	address &= 0xfffff000;
 	tmp = address - current->start_code;
+	if ((vma = find_vma(tmp))) {
+		vma_no_page(vma,address);
+		return;
+	}
 	if (!current->executable || tmp >= current->end_data) {
 		get_empty_page(address);
 		return;
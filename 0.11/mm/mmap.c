@@ -0,0 +1,260 @@
+/*
+ *  linux/mm/mmap.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * mmap.c maps files (and anonymous memory) into the data space of a
+ * task. Nothing is read at mmap() time: the pages are faulted in by
+ * do_no_page() much like the executable's are, only from any inode at
+ * any offset. Private mappings are copy-on-write like all other pages
+ * after fork(). Shared ones stay shared over fork(), and their dirty
+ * pages are written back to the file when they are unmapped.
+ *
+ * There is no page cache, so two tasks that map a file shared each
+ * see their own pages until they are written back.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <asm/segment.h>
+
+#define invalidate() \
+__asm__("movl %%eax,%%cr3"::"a" (0))
+
+/* the address is relative to the data space of the current task */
+struct vm_area * find_vma(unsigned long addr)
+{
+	struct vm_area * vma;
+
+	for (vma = current->mmap ; vma < current->mmap+NR_MMAP ; vma++)
+		if (vma->vm_end && addr >= vma->vm_start && addr < vma->vm_end)
+			return vma;
+	return NULL;
+}
+
+/* fill a new page of a file mapping; the page is zeroed already */
+void read_vma_page(struct vm_area * vma, unsigned long addr,
+	unsigned long page)
+{
+	struct m_inode * inode = vma->vm_inode;
+	unsigned long offset = vma->vm_offset + addr - vma->vm_start;
+	int nr[4], i;
+
+	for (i=0 ; i<4 ; i++)
+		if (offset + i*BLOCK_SIZE < inode->i_size)
+			nr[i] = bmap(inode,(offset >> BLOCK_SIZE_BITS) + i);
+		else
+			nr[i] = 0;
+	bread_page(page,inode->i_dev,nr);
+	if (offset < inode->i_size && inode->i_size - offset < PAGE_SIZE)
+		memset((char *) page + inode->i_size - offset, 0,
+			PAGE_SIZE - (inode->i_size - offset));
+}
+
+/* write a dirty page of a shared mapping back, but not past the end */
+static void write_vma_page(struct vm_area * vma, unsigned long addr,
+	unsigned long page)
+{
+	struct m_inode * inode = vma->vm_inode;
+	unsigned long offset = vma->vm_offset + addr - vma->vm_start;
+	struct buffer_head * bh;
+	int i, nr, chars;
+
+	for (i=0 ; i<4 && offset < inode->i_size ; i++,offset += BLOCK_SIZE) {
+		chars = BLOCK_SIZE;
+		if (inode->i_size - offset < BLOCK_SIZE)
+			chars = inode->i_size - offset;
+		if (!(nr = create_block(inode,offset >> BLOCK_SIZE_BITS)))
+			break;
+		if (chars == BLOCK_SIZE)
+			bh = getblk(inode->i_dev,nr);
+		else if (!(bh = bread(inode->i_dev,nr)))
+			break;
+		memcpy(bh->b_data,(char *) page + i*BLOCK_SIZE,chars);
+		bh->b_uptodate = 1;
+		bh->b_dirt = 1;
+		brelse(bh);
+	}
+	inode->i_mtime = inode->i_ctime = CURRENT_TIME;
+	inode->i_dirt = 1;
+}
+
+/* drop the pages of [from,to) in an area, writing back dirty shared ones */
+static void unmap_pages(struct vm_area * vma, unsigned long from,
+	unsigned long to)
+{
+	unsigned long addr, * dir, * pte, page;
+
+	for (addr = from ; addr < to ; addr += PAGE_SIZE) {
+		dir = (unsigned long *) (((current->start_code + addr) >> 20) & 0xffc);
+		if (!(*dir & 1))
+			continue;
+		pte = (unsigned long *) (0xfffff000 & *dir) +
+			(((current->start_code + addr) >> 12) & 0x3ff);
+		if (!(*pte & 1))
+			continue;
+		page = *pte & 0xfffff000;
+		if (vma->vm_inode && (vma->vm_flags & MAP_SHARED) &&
+		    (*pte & 0x40))
+			write_vma_page(vma,addr,page);
+		*pte = 0;
+		free_page(page);
+	}
+	invalidate();
+}
+
+int sys_munmap(unsigned long addr, unsigned long len)
+{
+	struct vm_area * vma, * new = NULL;
+	unsigned long end, from, to;
+	int split = 0;
+
+	if ((addr & (PAGE_SIZE-1)) || !len)
+		return -EINVAL;
+	end = (addr + len + PAGE_SIZE-1) & ~(PAGE_SIZE-1);
+	for (vma = current->mmap ; vma < current->mmap+NR_MMAP ; vma++)
+		if (!vma->vm_end)
+			new = vma;
+		else if (vma->vm_start < addr && end < vma->vm_end)
+			split = 1;
+	if (split && !new)
+		return -ENOMEM;		/* a hole would need another area */
+	for (vma = current->mmap ; vma < current->mmap+NR_MMAP ; vma++) {
+		if (!vma->vm_end || vma->vm_end <= addr || vma->vm_start >= end)
+			continue;
+		from = (addr > vma->vm_start) ? addr : vma->vm_start;
+		to = (end < vma->vm_end) ? end : vma->vm_end;
+		unmap_pages(vma,from,to);
+		if (from == vma->vm_start && to == vma->vm_end) {
+			iput(vma->vm_inode);
+			vma->vm_inode = NULL;
+			vma->vm_end = 0;
+		} else if (from == vma->vm_start) {
+			vma->vm_offset += to - vma->vm_start;
+			vma->vm_start = to;
+		} else if (to == vma->vm_end)
+			vma->vm_end = from;
+		else {
+			*new = *vma;
+			new->vm_offset += to - vma->vm_start;
+			new->vm_start = to;
+			if (new->vm_inode)
+				new->vm_inode->i_count++;
+			vma->vm_end = from;
+		}
+	}
+	return 0;
+}
+
+/* a free address range of 'len' bytes between MMAP_BASE and MMAP_END */
+static unsigned long get_unmapped_area(unsigned long len)
+{
+	struct vm_area * vma;
+	unsigned long addr = MMAP_BASE;
+
+repeat:
+	if (addr + len > MMAP_END || addr + len < addr)
+		return 0;
+	for (vma = current->mmap ; vma < current->mmap+NR_MMAP ; vma++)
+		if (vma->vm_end && vma->vm_start < addr + len &&
+		    vma->vm_end > addr) {
+			addr = vma->vm_end;
+			goto repeat;
+		}
+	return addr;
+}
+
+int sys_mmap(struct mmap_args * args)
+{
+	struct vm_area * vma;
+	struct m_inode * inode = NULL;
+	struct file * file;
+	unsigned long addr, len, offset;
+	int prot, flags, fd, retval, n;
+
+	addr = get_fs_long((unsigned long *) &args->addr);
+	len = get_fs_long((unsigned long *) &args->len);
+	prot = get_fs_long((unsigned long *) &args->prot);
+	flags = get_fs_long((unsigned long *) &args->flags);
+	fd = get_fs_long((unsigned long *) &args->fd);
+	offset = get_fs_long((unsigned long *) &args->offset);
+	if (!len || len > MMAP_END - MMAP_BASE)
+		return -EINVAL;
+	len = (len + PAGE_SIZE-1) & ~(PAGE_SIZE-1);
+	if ((flags & MAP_TYPE) != MAP_SHARED && (flags & MAP_TYPE) != MAP_PRIVATE)
+		return -EINVAL;
+	if (!(flags & MAP_ANONYMOUS)) {
+		if (fd >= NR_OPEN || fd < 0 || !(file = current->filp[fd]))
+			return -EBADF;
+		inode = file->f_inode;
+		if (!S_ISREG(inode->i_mode))
+			return -ENODEV;
+		if (offset & (PAGE_SIZE-1))
+			return -EINVAL;
+		if ((file->f_flags & O_ACCMODE) == O_WRONLY)
+			return -EACCES;
+		if ((flags & MAP_TYPE) == MAP_SHARED && (prot & PROT_WRITE) &&
+		    (file->f_flags & O_ACCMODE) == O_RDONLY)
+			return -EACCES;
+	} else
+		offset = 0;
+	if (flags & MAP_FIXED) {
+		if ((addr & (PAGE_SIZE-1)) || addr < MMAP_BASE ||
+		    addr + len > MMAP_END || addr + len < addr)
+			return -EINVAL;
+/* there must be a slot for us after the unmap: count them first */
+		for (n = 0, vma = current->mmap ; vma < current->mmap+NR_MMAP ; vma++)
+			if (!vma->vm_end || (vma->vm_start >= addr &&
+			    vma->vm_end <= addr + len))
+				n++;
+			else if (vma->vm_start < addr && addr + len < vma->vm_end)
+				n--;		/* split in two */
+		if (n <= 0)
+			return -ENOMEM;
+		if ((retval = sys_munmap(addr,len)))
+			return retval;
+	} else if (!(addr = get_unmapped_area(len)))
+		return -ENOMEM;
+	for (vma = current->mmap ; vma < current->mmap+NR_MMAP ; vma++)
+		if (!vma->vm_end)
+			break;
+	if (vma >= current->mmap+NR_MMAP)
+		return -ENOMEM;
+	vma->vm_start = addr;
+	vma->vm_end = addr + len;
+	vma->vm_inode = inode;
+	vma->vm_offset = offset;
+	vma->vm_prot = prot;
+	vma->vm_flags = flags;
+	if (inode)
+		inode->i_count++;
+	return addr;
+}
+
+/* the child got copies of our areas */
+void fork_mmap(struct task_struct * p)
+{
+	int i;
+
+	for (i=0 ; i<NR_MMAP ; i++)
+		if (p->mmap[i].vm_end && p->mmap[i].vm_inode)
+			p->mmap[i].vm_inode->i_count++;
+}
+
+/* called on exit and exec, before the page tables go */
+void exit_mmap(void)
+{
+	struct vm_area * vma;
+
+	for (vma = current->mmap ; vma < current->mmap+NR_MMAP ; vma++)
+		if (vma->vm_end)
+			sys_munmap(vma->vm_start,vma->vm_end - vma->vm_start);
+}